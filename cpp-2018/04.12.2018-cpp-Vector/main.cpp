@@ -1,21 +1,335 @@
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iostream> // danil loh
+#include <iterator>
+#include <list>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <new>
+#include <stdexcept>
+#include <sstream>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#ifdef WITH_PARALLEL_STL
+#include <execution>
+#endif  // WITH_PARALLEL_STL
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VECTOR_SIMD_X86
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
+// Поиск элементов, равных заданному, в непрерывном массиве.
+//
+// Для арифметических типов размером 1, 2, 4 и 8 байт на x86 сравнивается
+// сразу по 16 (SSE2) или 32 (AVX2) байта; набор инструкций выбирается
+// во время выполнения. Для остальных типов и платформ используется обычный
+// цикл. Результаты совпадают с поэлементным сравнением через ==, в том числе
+// для NaN и нулей разного знака.
+
+// Значение, означающее "элемент не найден".
+constexpr size_t kNotFound = std::numeric_limits<size_t>::max();
+
+template<typename T>
+size_t FindEqualScalar(const T* data, size_t size, const T& value) {
+  for (size_t i = 0; i < size; ++i) {
+    if (data[i] == value) {
+      return i;
+    }
+  }
+  return kNotFound;
+}
+
+template<typename T>
+size_t CountEqualScalar(const T* data, size_t size, const T& value) {
+  size_t count = 0;
+  for (size_t i = 0; i < size; ++i) {
+    count += data[i] == value;
+  }
+  return count;
+}
+
+#ifdef VECTOR_SIMD_X86
+
+template<typename T>
+constexpr bool kSimdSearchable = std::is_arithmetic_v<T>
+    && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4
+        || sizeof(T) == 8);
+
+// Массив из 'kLanes' копий 'value', загружаемый в регистр
+// вызывающей функцией.
+template<typename T, size_t kLanes>
+struct BroadcastLanes {
+  T lanes[kLanes];
+
+  explicit BroadcastLanes(T value) {
+    std::fill(lanes, lanes + kLanes, value);
+  }
+};
+
+// Битовая маска (по биту на байт) ячеек блока 'data', равных 'needle'.
+template<typename T>
+unsigned Sse2EqualMask(const T* data, __m128i needle) {
+  __m128i equal;
+  if constexpr (std::is_same_v<T, float>) {
+    equal = _mm_castps_si128(_mm_cmpeq_ps(
+        _mm_loadu_ps(data), _mm_castsi128_ps(needle)));
+  } else if constexpr (std::is_same_v<T, double>) {
+    equal = _mm_castpd_si128(_mm_cmpeq_pd(
+        _mm_loadu_pd(data), _mm_castsi128_pd(needle)));
+  } else {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    if constexpr (sizeof(T) == 1) {
+      equal = _mm_cmpeq_epi8(block, needle);
+    } else if constexpr (sizeof(T) == 2) {
+      equal = _mm_cmpeq_epi16(block, needle);
+    } else if constexpr (sizeof(T) == 4) {
+      equal = _mm_cmpeq_epi32(block, needle);
+    } else {
+      // В SSE2 нет сравнения 64-битных чисел: обе 32-битные половины
+      // должны совпасть.
+      equal = _mm_cmpeq_epi32(block, needle);
+      equal = _mm_and_si128(equal,
+                            _mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+  }
+  return static_cast<unsigned>(_mm_movemask_epi8(equal));
+}
+
+template<typename T>
+__attribute__((target("avx2")))
+unsigned Avx2EqualMask(const T* data, __m256i needle) {
+  __m256i equal;
+  if constexpr (std::is_same_v<T, float>) {
+    equal = _mm256_castps_si256(_mm256_cmp_ps(
+        _mm256_loadu_ps(data), _mm256_castsi256_ps(needle), _CMP_EQ_OQ));
+  } else if constexpr (std::is_same_v<T, double>) {
+    equal = _mm256_castpd_si256(_mm256_cmp_pd(
+        _mm256_loadu_pd(data), _mm256_castsi256_pd(needle), _CMP_EQ_OQ));
+  } else {
+    __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    if constexpr (sizeof(T) == 1) {
+      equal = _mm256_cmpeq_epi8(block, needle);
+    } else if constexpr (sizeof(T) == 2) {
+      equal = _mm256_cmpeq_epi16(block, needle);
+    } else if constexpr (sizeof(T) == 4) {
+      equal = _mm256_cmpeq_epi32(block, needle);
+    } else {
+      equal = _mm256_cmpeq_epi64(block, needle);
+    }
+  }
+  return static_cast<unsigned>(_mm256_movemask_epi8(equal));
+}
+
+template<typename T>
+size_t Sse2FindEqual(const T* data, size_t size, T value) {
+  constexpr size_t kLanes = sizeof(__m128i) / sizeof(T);
+  BroadcastLanes<T, kLanes> broadcast(value);
+  __m128i needle =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(broadcast.lanes));
+  size_t i = 0;
+  for (; i + kLanes <= size; i += kLanes) {
+    unsigned mask = Sse2EqualMask(data + i, needle);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask) / sizeof(T);
+    }
+  }
+  size_t tail = FindEqualScalar(data + i, size - i, value);
+  return tail == kNotFound ? kNotFound : i + tail;
+}
+
+template<typename T>
+__attribute__((target("avx2")))
+size_t Avx2FindEqual(const T* data, size_t size, T value) {
+  constexpr size_t kLanes = sizeof(__m256i) / sizeof(T);
+  BroadcastLanes<T, kLanes> broadcast(value);
+  __m256i needle =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(broadcast.lanes));
+  size_t i = 0;
+  // Два блока за итерацию: ветвление проверяется реже.
+  for (; i + 2 * kLanes <= size; i += 2 * kLanes) {
+    unsigned first = Avx2EqualMask(data + i, needle);
+    unsigned second = Avx2EqualMask(data + i + kLanes, needle);
+    if ((first | second) != 0) {
+      return first != 0 ? i + __builtin_ctz(first) / sizeof(T)
+                        : i + kLanes + __builtin_ctz(second) / sizeof(T);
+    }
+  }
+  size_t tail = FindEqualScalar(data + i, size - i, value);
+  return tail == kNotFound ? kNotFound : i + tail;
+}
+
+template<typename T>
+size_t Sse2CountEqual(const T* data, size_t size, T value) {
+  constexpr size_t kLanes = sizeof(__m128i) / sizeof(T);
+  BroadcastLanes<T, kLanes> broadcast(value);
+  __m128i needle =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(broadcast.lanes));
+  size_t matched_bytes = 0;
+  size_t i = 0;
+  for (; i + kLanes <= size; i += kLanes) {
+    matched_bytes += __builtin_popcount(Sse2EqualMask(data + i, needle));
+  }
+  return matched_bytes / sizeof(T)
+      + CountEqualScalar(data + i, size - i, value);
+}
+
+template<typename T>
+__attribute__((target("avx2,popcnt")))
+size_t Avx2CountEqual(const T* data, size_t size, T value) {
+  constexpr size_t kLanes = sizeof(__m256i) / sizeof(T);
+  BroadcastLanes<T, kLanes> broadcast(value);
+  __m256i needle =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(broadcast.lanes));
+  size_t matched_bytes = 0;
+  size_t i = 0;
+  for (; i + kLanes <= size; i += kLanes) {
+    matched_bytes += __builtin_popcount(Avx2EqualMask(data + i, needle));
+  }
+  return matched_bytes / sizeof(T)
+      + CountEqualScalar(data + i, size - i, value);
+}
+
+inline bool CpuSupportsAvx2() {
+  static const bool kSupported = __builtin_cpu_supports("avx2")
+      && __builtin_cpu_supports("popcnt");
+  return kSupported;
+}
+
+#endif  // VECTOR_SIMD_X86
+
+// Возвращает позицию первого элемента data[0..size), равного 'value',
+// либо kNotFound.
+template<typename T>
+size_t FindEqual(const T* data, size_t size, const T& value) {
+#ifdef VECTOR_SIMD_X86
+  if constexpr (kSimdSearchable<T>) {
+    return CpuSupportsAvx2() ? Avx2FindEqual(data, size, value)
+                             : Sse2FindEqual(data, size, value);
+  }
+#endif  // VECTOR_SIMD_X86
+  return FindEqualScalar(data, size, value);
+}
+
+// Возвращает количество элементов data[0..size), равных 'value'.
+template<typename T>
+size_t CountEqual(const T* data, size_t size, const T& value) {
+#ifdef VECTOR_SIMD_X86
+  if constexpr (kSimdSearchable<T>) {
+    return CpuSupportsAvx2() ? Avx2CountEqual(data, size, value)
+                             : Sse2CountEqual(data, size, value);
+  }
+#endif  // VECTOR_SIMD_X86
+  return CountEqualScalar(data, size, value);
+}
+
 template<typename T>
 class VectorInternalsAccessor;
 
+// Категория итератора 'It'; используется, чтобы шаблонные перегрузки,
+// принимающие диапазоны, не перехватывали вызовы с целыми числами.
+template<typename It>
+using IteratorCategory = typename std::iterator_traits<It>::iterator_category;
+
+// Стратегии изменения размера массива Vector.
+//
+// Grow(allocated, required) возвращает новый размер массива, вмещающего
+// хотя бы 'required' элементов, если сейчас он вмещает 'allocated'.
+// Shrink(allocated, size) возвращает размер, до которого следует уменьшить
+// массив после удаления элемента, либо 'allocated', если уменьшать его
+// не нужно. Между порогами увеличения (массив заполнен) и уменьшения
+// (заполнен меньше чем на четверть) оставлен зазор, чтобы чередование
+// вставок и удалений вблизи границы не приводило к переездам на каждой
+// операции.
+
+// Увеличение вдвое.
+struct DoublingGrowth {
+  static size_t Grow(size_t allocated, size_t required) {
+    return std::max(required, allocated * 2);
+  }
+  static size_t Shrink(size_t allocated, size_t size) {
+    return size < allocated / 4 ? allocated / 2 : allocated;
+  }
+};
+
+// Увеличение в полтора раза: меньше неиспользуемой памяти ценой
+// более частых переездов.
+struct HalfGrowth {
+  static size_t Grow(size_t allocated, size_t required) {
+    return std::max(required, allocated + allocated / 2);
+  }
+  static size_t Shrink(size_t allocated, size_t size) {
+    return size < allocated / 4 ? allocated / 2 : allocated;
+  }
+};
+
+// Увеличение на фиксированное число элементов.
+template<size_t kChunk>
+struct FixedChunkGrowth {
+  static_assert(kChunk > 0, "FixedChunkGrowth needs a positive chunk");
+
+  static size_t Grow(size_t allocated, size_t required) {
+    return std::max(required, allocated + kChunk);
+  }
+  static size_t Shrink(size_t allocated, size_t size) {
+    return size + 2 * kChunk < allocated ? allocated - kChunk : allocated;
+  }
+};
+
+// Стратегия 'Growth', никогда не уменьшающая массив автоматически;
+// память возвращается только явным вызовом ShrinkToFit.
+template<typename Growth>
+struct NoAutoShrink : Growth {
+  static size_t Shrink(size_t allocated, size_t) {
+    return allocated;
+  }
+};
+
 // Контейнер Vector (динамический массив)
-template<typename T>
+//
+// Элементы хранятся непрерывно, но не обязательно с начала выделенной
+// памяти: перед ними и после них оставляется запас, поэтому вставка и
+// удаление как в конце, так и в начале вектора работают за амортизированное
+// O(1).
+//
+// Память выделяется через 'Alloc' (аллокатор, совместимый с std::allocator);
+// пустой вектор память не выделяет вовсе. Размер массива меняется согласно
+// стратегии 'Growth' (см. DoublingGrowth).
+template<typename T, typename Alloc = std::allocator<T>,
+         typename Growth = DoublingGrowth>
 class Vector {
  public:
-  // Конструктор по умолчанию, выполняющий резервацию в 'data_'
-  // памяти для хранения одного элемента.
-  Vector();
+  // Итераторы - обычные указатели: элементы лежат в памяти подряд, поэтому
+  // вектор можно передавать в алгоритмы стандартной библиотеки (в том числе
+  // параллельные) и обходить циклом range-for.
+  using value_type = T;
+  using allocator_type = Alloc;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  // Конструктор по умолчанию. Память не выделяется до добавления
+  // первого элемента.
+  Vector() noexcept(noexcept(Alloc()));
+
+  // Конструктор пустого вектора, использующего заданный аллокатор.
+  explicit Vector(const Alloc& allocator) noexcept;
 
   // Деструктор, выполняющий очистку занимаемой элементами
   // вектора памяти.
@@ -23,13 +337,28 @@ class Vector {
 
   // Возможность копирования объектов типа Vector<T>
   // через конструктор копирования или оператор копирующего присваивания.
+  // Копия занимает ровно столько памяти, сколько нужно под элементы.
+  // Присваивание использует уже выделенную память, если её хватает и
+  // копирование элементов не бросает исключений; иначе копия строится
+  // в новом массиве. В обоих случаях при исключении вектор не меняется.
   Vector(const Vector& other);
   Vector& operator=(const Vector& other);
 
   // Возможность копирования объектов типа Vector<T>
   // через конструктор перемещения или оператор перемещающего присваивания.
+  // Вектор, из которого переместили элементы, остаётся пустым и не владеет
+  // памятью.
   Vector(Vector&& other) noexcept;
-  Vector& operator=(Vector&& other) noexcept;
+  Vector& operator=(Vector&& other) noexcept(
+      std::allocator_traits<Alloc>::propagate_on_container_move_assignment
+          ::value
+      || std::allocator_traits<Alloc>::is_always_equal::value);
+
+  // Обменивает содержимое двух векторов без копирования элементов.
+  void Swap(Vector& other) noexcept;
+
+  // Возвращает аллокатор вектора.
+  Alloc GetAllocator() const;
 
   // Возвращает количество элементов в векторе.
   size_t Size() const;
@@ -37,6 +366,19 @@ class Vector {
   // Проверяет вектор на пустоту.
   bool IsEmpty() const;
 
+  // Возвращает количество элементов, которое вектор вмещает без переезда
+  // при добавлении в конец. Запас перед первым элементом сюда не входит.
+  size_t Capacity() const;
+
+  // Переносит элементы так, чтобы вектор вмещал хотя бы 'capacity'
+  // элементов без переезда при добавлении в конец. Запас перед первым
+  // элементом при этом не сохраняется.
+  void Reserve(size_t capacity);
+
+  // Уменьшает массив до количества элементов; пустой вектор освобождает
+  // память полностью.
+  void ShrinkToFit();
+
   // Метод, добавлялющий элемент в конец вектора.
   void PushBack(const T& value);
 
@@ -54,216 +396,1437 @@ class Vector {
   T& operator[](size_t ind);
   const T& operator[](size_t ind) const;
 
+  // Указатель на первый элемент; элементы занимают [Data(), Data() + Size()).
+  T* Data();
+  const T* Data() const;
+
+  // Итераторы на начало и конец вектора.
+  iterator begin();
+  iterator end();
+  const_iterator begin() const;
+  const_iterator end() const;
+  const_iterator cbegin() const;
+  const_iterator cend() const;
+
   // Метод, добавлялющий элемент в конец вектора
-  // аналогично соответствующему методу в std::vector
+  // аналогично соответствующему методу в std::vector.
+  // Элемент конструируется прямо в памяти вектора, без временных объектов;
+  // возвращается ссылка на него.
   template<typename... Args>
-  void EmplaceBack(Args&& ... args);
+  T& EmplaceBack(Args&& ... args);
 
   // Метод, добавлялющий элемент в начало вектора
   // аналогично соответствующему методу в std::vector
   template<typename... Args>
-  void EmplaceFront(Args&& ... args);
-
-  // Метод, возвращающий позицию в векторе
-  // либо "-1", если элемент в векторе отстутствует.
-  int Find(const T& value) const;
+  T& EmplaceFront(Args&& ... args);
+
+  // Дописывает в конец вектора элементы диапазона [first, last).
+  // Если длину диапазона можно узнать заранее, массив увеличивается не более
+  // одного раза, а тривиально копируемые элементы из обычного массива
+  // копируются одним memcpy. Диапазон может состоять из элементов самого
+  // вектора.
+  template<typename InputIt, typename = IteratorCategory<InputIt>>
+  void Append(InputIt first, InputIt last);
+
+  // Вставляет элементы диапазона [first, last) перед 'pos' и возвращает
+  // итератор на первый из вставленных элементов. Массив увеличивается не
+  // более одного раза. Диапазон не должен состоять из элементов вектора.
+  template<typename InputIt, typename = IteratorCategory<InputIt>>
+  iterator Insert(const_iterator pos, InputIt first, InputIt last);
+
+  // Изменяет количество элементов на 'size', удаляя лишние элементы с конца
+  // либо дописывая в конец элементы, созданные конструктором по умолчанию
+  // (копии 'value' соответственно).
+  void Resize(size_t size);
+  void Resize(size_t size, const T& value);
+
+  // Заменяет содержимое вектора элементами диапазона [first, last)
+  // (соответственно 'count' копиями 'value'). Диапазон не должен состоять
+  // из элементов вектора.
+  template<typename InputIt, typename = IteratorCategory<InputIt>>
+  void Assign(InputIt first, InputIt last);
+  void Assign(size_t count, const T& value);
+
+  // Значение, возвращаемое Find при отсутствии элемента.
+  static constexpr size_t npos = kNotFound;
+
+  // Метод, возвращающий позицию первого вхождения элемента в векторе
+  // либо npos, если элемент в векторе отстутствует.
+  // Для арифметических типов сравнение векторизовано.
+  size_t Find(const T& value) const;
+
+  // Возвращает позиции всех вхождений элемента в порядке возрастания.
+  Vector<size_t> FindAll(const T& value) const;
+
+  // Возвращает количество вхождений элемента.
+  size_t Count(const T& value) const;
 
  protected:
   friend class VectorInternalsAccessor<T>;  // DO_NOT_CHANGE
 
+  using AllocTraits = std::allocator_traits<Alloc>;
+
+  // Проверяет, переопределяет ли аллокатор конструирование элементов.
+  template<typename A, typename = void>
+  struct HasCustomConstruct : std::false_type {};
+  template<typename A>
+  struct HasCustomConstruct<A, std::void_t<decltype(std::declval<A&>()
+      .construct(std::declval<T*>(), std::declval<T&&>()))>>
+      : std::true_type {};
+
+  // Можно ли переносить элементы побайтовым копированием.
+  static constexpr bool kRelocateByMemcpy =
+      std::is_trivially_copyable_v<T>
+          && (std::is_same_v<Alloc, std::allocator<T>>
+              || !HasCustomConstruct<Alloc>::value);
+
   // Количество элементов, содержащихся в массиве
   size_t size_;
 
   // Размер массива data_
   size_t allocated_size_;
 
-  //указатель на массив с элементами.
+  // Позиция первого элемента в data_: элементы занимают
+  // отрезок [begin_, begin_ + size_).
+  size_t begin_;
+
+  // Указатель на неинициализированную память под allocated_size_
+  // элементов, из которых сконструированы лишь первые size_.
   T* data_;
 
+  // Аллокатор, через который выделяется память под data_.
+  [[no_unique_address]] Alloc allocator_;
+
   // Метод, изменяющий размер хранимого в data_ массива.
-  void Relocate(size_t new_size);
+  // Элементы размещаются в новом массиве начиная с позиции 'new_begin'.
+  void Relocate(size_t new_size, size_t new_begin);
+
+  // Переносит элементы в новый массив размера 'new_size' так же, как
+  // Relocate, но оставляет между первыми 'position' элементами и остальными
+  // 'count' слотов, которые заполняет вызов 'construct_gap(gap)'. Новые
+  // элементы создаются до переноса старых, поэтому могут быть копиями
+  // элементов самого вектора. 'construct_gap' при исключении должна сама
+  // разрушить то, что успела создать.
+  template<typename ConstructGap>
+  void RelocateWithGap(size_t new_size, size_t new_begin, size_t position,
+                       size_t count, ConstructGap construct_gap);
+
+  // Увеличивает массив согласно стратегии Growth так, чтобы в нём
+  // поместились ещё 'count' элементов, и заполняет их на позиции
+  // 'position' через 'construct_gap' (см. RelocateWithGap).
+  template<typename ConstructGap>
+  void GrowWithGap(size_t position, size_t count, ConstructGap construct_gap);
+
+  // Конструирует в неинициализированной памяти 'to' копии 'count'
+  // элементов, начиная с 'first'. При исключении разрушает созданное.
+  template<typename ForwardIt>
+  void ConstructRange(T* to, ForwardIt first, size_t count);
+
+  // Конструирует в 'to' 'count' элементов из 'args'.
+  // При исключении разрушает созданное.
+  template<typename... Args>
+  void ConstructFill(T* to, size_t count, const Args& ... args);
+
+  // Общая часть обеих перегрузок Resize.
+  template<typename... Args>
+  void ResizeWith(size_t size, const Args& ... args);
+
+  // Уменьшает массив, если этого требует стратегия Growth.
+  void ShrinkIfSparse();
+
+  // Разрушает все элементы и освобождает data_.
+  void Release();
+
+  // Выделение и освобождение "сырой" памяти под 'count' элементов
+  // без вызова конструкторов и деструкторов.
+  T* Allocate(size_t count);
+  void Deallocate(T* data, size_t count);
+
+  // Конструирование и разрушение элементов через аллокатор.
+  template<typename... Args>
+  void Construct(T* place, Args&& ... args);
+  void Destroy(T* data, size_t count);
+
+  // Переносит 'count' сконструированных элементов из 'from'
+  // в неинициализированную память 'to' и разрушает исходные.
+  // Элементы перемещаются, если перемещение не бросает исключений,
+  // а тривиально копируемые типы переносятся одним memcpy.
+  void RelocateElements(T* from, size_t count, T* to);
+
+  // То же, что RelocateElements, но исходные элементы не разрушаются.
+  // При исключении созданные в 'to' элементы разрушаются.
+  void TransferElements(T* from, size_t count, T* to);
 };
 
 template<typename T>
 class VectorInternalsAccessor {
  public:
   VectorInternalsAccessor() = delete;
-  static size_t Size(const Vector<T>& vector) {
+  template<typename Alloc, typename Growth>
+  static size_t Size(const Vector<T, Alloc, Growth>& vector) {
     return vector.size_;
   }
-  static T* AllocData(const Vector<T>& vector) {
+  template<typename Alloc, typename Growth>
+  static T* AllocData(const Vector<T, Alloc, Growth>& vector) {
     return vector.data_;
   }
-  static size_t AllocSize(const Vector<T>& vector) {
+  template<typename Alloc, typename Growth>
+  static size_t AllocSize(const Vector<T, Alloc, Growth>& vector) {
     return vector.allocated_size_;
   }
 };
 
-template<typename T>
-Vector<T>::Vector() :
+template<typename T, typename Alloc, typename Growth>
+Vector<T, Alloc, Growth>::Vector() noexcept(noexcept(Alloc())) :
+    size_(0),
+    allocated_size_(0),
+    begin_(0),
+    data_(nullptr),
+    allocator_() {}
+
+template<typename T, typename Alloc, typename Growth>
+Vector<T, Alloc, Growth>::Vector(const Alloc& allocator) noexcept :
     size_(0),
-    allocated_size_(1),
-    data_(new T[1]) {}
+    allocated_size_(0),
+    begin_(0),
+    data_(nullptr),
+    allocator_(allocator) {}
+
+template<typename T, typename Alloc, typename Growth>
+Vector<T, Alloc, Growth>::~Vector() {
+  Release();
+}
+
+template<typename T, typename Alloc, typename Growth>
+Vector<T, Alloc, Growth>::Vector(const Vector& other)
+    : size_(0),
+      allocated_size_(0),
+      begin_(0),
+      data_(nullptr),
+      allocator_(AllocTraits::select_on_container_copy_construction(
+          other.allocator_)) {
+  data_ = Allocate(other.size_);
+  allocated_size_ = other.size_;
+  try {
+    ConstructRange(data_, other.Data(), other.size_);
+  } catch (...) {
+    Deallocate(data_, allocated_size_);
+    throw;
+  }
+  size_ = other.size_;
+}
+
+template<typename T, typename Alloc, typename Growth>
+Vector<T, Alloc, Growth>&
+Vector<T, Alloc, Growth>::operator=(const Vector& other) {
+  if (this == &other) {
+    return *this;
+  }
+  if constexpr (AllocTraits::propagate_on_container_copy_assignment::value) {
+    if (allocator_ != other.allocator_) {
+      Vector copy(other.allocator_);
+      copy.Append(other.begin(), other.end());
+      Release();
+      allocator_ = other.allocator_;
+      Swap(copy);
+      return *this;
+    }
+    allocator_ = other.allocator_;
+  }
+  if (std::is_nothrow_copy_constructible_v<T>
+      && other.size_ <= allocated_size_) {
+    Destroy(Data(), size_);
+    size_ = 0;
+    begin_ = 0;
+    ConstructRange(data_, other.Data(), other.size_);
+    size_ = other.size_;
+  } else {
+    Vector copy(allocator_);
+    copy.Append(other.begin(), other.end());
+    Swap(copy);
+  }
+  return *this;
+}
+
+template<typename T, typename Alloc, typename Growth>
+Vector<T, Alloc, Growth>::Vector(Vector&& other) noexcept
+    : size_(other.size_),
+      allocated_size_(other.allocated_size_),
+      begin_(other.begin_),
+      data_(other.data_),
+      allocator_(std::move(other.allocator_)) {
+  other.size_ = 0;
+  other.allocated_size_ = 0;
+  other.begin_ = 0;
+  other.data_ = nullptr;
+}
+
+template<typename T, typename Alloc, typename Growth>
+Vector<T, Alloc, Growth>&
+Vector<T, Alloc, Growth>::operator=(Vector&& other) noexcept(
+    std::allocator_traits<Alloc>::propagate_on_container_move_assignment
+        ::value
+    || std::allocator_traits<Alloc>::is_always_equal::value) {
+  if (this == &other) {
+    return *this;
+  }
+  if constexpr (!AllocTraits::propagate_on_container_move_assignment::value
+      && !AllocTraits::is_always_equal::value) {
+    if (allocator_ != other.allocator_) {
+      // Чужую память забрать нельзя: переносим элементы поштучно.
+      Destroy(data_ + begin_, size_);
+      size_ = 0;
+      begin_ = 0;
+      if (allocated_size_ < other.size_) {
+        T* new_data = Allocate(other.size_);
+        Deallocate(data_, allocated_size_);
+        data_ = new_data;
+        allocated_size_ = other.size_;
+      }
+      for (; size_ < other.size_; ++size_) {
+        Construct(data_ + size_, std::move(other[size_]));
+      }
+      other.Release();
+      return *this;
+    }
+  }
+  Release();
+  if constexpr (AllocTraits::propagate_on_container_move_assignment::value) {
+    allocator_ = std::move(other.allocator_);
+  }
+  size_ = other.size_;
+  allocated_size_ = other.allocated_size_;
+  begin_ = other.begin_;
+  data_ = other.data_;
+
+  other.size_ = 0;
+  other.allocated_size_ = 0;
+  other.begin_ = 0;
+  other.data_ = nullptr;
+  return *this;
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::Swap(Vector& other) noexcept {
+  if constexpr (AllocTraits::propagate_on_container_swap::value) {
+    std::swap(allocator_, other.allocator_);
+  } else {
+    assert(allocator_ == other.allocator_);
+  }
+  std::swap(size_, other.size_);
+  std::swap(allocated_size_, other.allocated_size_);
+  std::swap(begin_, other.begin_);
+  std::swap(data_, other.data_);
+}
+
+template<typename T, typename Alloc, typename Growth>
+Alloc Vector<T, Alloc, Growth>::GetAllocator() const {
+  return allocator_;
+}
+
+template<typename T, typename Alloc, typename Growth>
+size_t Vector<T, Alloc, Growth>::Size() const {
+  return size_;
+}
+
+template<typename T, typename Alloc, typename Growth>
+bool Vector<T, Alloc, Growth>::IsEmpty() const {
+  return size_ == 0;
+}
+
+template<typename T, typename Alloc, typename Growth>
+size_t Vector<T, Alloc, Growth>::Capacity() const {
+  // Пустой вектор начинает добавление с начала массива.
+  return size_ == 0 ? allocated_size_ : allocated_size_ - begin_;
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::Reserve(size_t capacity) {
+  if (capacity > Capacity()) {
+    Relocate(std::max(capacity, allocated_size_), 0);
+  }
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::ShrinkToFit() {
+  if (size_ == 0) {
+    Release();
+  } else if (size_ < allocated_size_) {
+    Relocate(size_, 0);
+  }
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::PushBack(const T& value) {
+  EmplaceBack(value);
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::PopBack() {
+  assert(size_ != 0);
+  --size_;
+  Destroy(data_ + begin_ + size_, 1);
+  ShrinkIfSparse();
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::PushFront(const T& value) {
+  EmplaceFront(value);
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::PopFront() {
+  assert(size_ != 0);
+  Destroy(data_ + begin_, 1);
+  ++begin_;
+  --size_;
+  ShrinkIfSparse();
+}
+
+template<typename T, typename Alloc, typename Growth>
+T const& Vector<T, Alloc, Growth>::operator[](size_t ind) const {
+  assert(ind < size_);
+  return data_[begin_ + ind];
+}
+
+template<typename T, typename Alloc, typename Growth>
+T& Vector<T, Alloc, Growth>::operator[](size_t ind) {
+  assert(ind < size_);
+  return data_[begin_ + ind];
+}
+
+template<typename T, typename Alloc, typename Growth>
+T* Vector<T, Alloc, Growth>::Data() {
+  return data_ + begin_;
+}
+
+template<typename T, typename Alloc, typename Growth>
+const T* Vector<T, Alloc, Growth>::Data() const {
+  return data_ + begin_;
+}
+
+template<typename T, typename Alloc, typename Growth>
+typename Vector<T, Alloc, Growth>::iterator
+Vector<T, Alloc, Growth>::begin() {
+  return Data();
+}
+
+template<typename T, typename Alloc, typename Growth>
+typename Vector<T, Alloc, Growth>::iterator Vector<T, Alloc, Growth>::end() {
+  return Data() + size_;
+}
+
+template<typename T, typename Alloc, typename Growth>
+typename Vector<T, Alloc, Growth>::const_iterator
+Vector<T, Alloc, Growth>::begin() const {
+  return Data();
+}
+
+template<typename T, typename Alloc, typename Growth>
+typename Vector<T, Alloc, Growth>::const_iterator
+Vector<T, Alloc, Growth>::end() const {
+  return Data() + size_;
+}
+
+template<typename T, typename Alloc, typename Growth>
+typename Vector<T, Alloc, Growth>::const_iterator
+Vector<T, Alloc, Growth>::cbegin() const {
+  return begin();
+}
+
+template<typename T, typename Alloc, typename Growth>
+typename Vector<T, Alloc, Growth>::const_iterator
+Vector<T, Alloc, Growth>::cend() const {
+  return end();
+}
+
+// Если запас в нужном конце исчерпан, массив увеличивается согласно
+// стратегии Growth (либо сохраняет размер, если он заполнен не более чем
+// наполовину), а элементы размещаются по центру, чтобы запас появился с обеих
+// сторон. Вектор, в начало которого ничего не добавлялось (begin_ == 0),
+// растёт только в конец.
+template<typename T, typename Alloc, typename Growth>
+template<typename... Args>
+T& Vector<T, Alloc, Growth>::EmplaceBack(Args&& ... args) {
+  if (begin_ + size_ == allocated_size_) {
+    if (size_ == 0 && allocated_size_ != 0) {
+      begin_ = 0;
+    } else {
+      GrowWithGap(size_, 1, [&](T* gap) {
+        Construct(gap, std::forward<Args>(args)...);
+      });
+      return data_[begin_ + size_ - 1];
+    }
+  }
+  Construct(data_ + begin_ + size_, std::forward<Args>(args)...);
+  ++size_;
+  return data_[begin_ + size_ - 1];
+}
+
+template<typename T, typename Alloc, typename Growth>
+template<typename... Args>
+T& Vector<T, Alloc, Growth>::EmplaceFront(Args&& ... args) {
+  if (begin_ == 0) {
+    if (size_ == 0 && allocated_size_ != 0) {
+      begin_ = allocated_size_;
+    } else {
+      size_t new_size = std::max(allocated_size_,
+                                 Growth::Grow(size_, size_ + 1));
+      RelocateWithGap(new_size, (new_size - size_) / 2, 0, 1, [&](T* gap) {
+        Construct(gap, std::forward<Args>(args)...);
+      });
+      return data_[begin_];
+    }
+  }
+  Construct(data_ + begin_ - 1, std::forward<Args>(args)...);
+  --begin_;
+  ++size_;
+  return data_[begin_];
+}
+
+template<typename T, typename Alloc, typename Growth>
+template<typename InputIt, typename>
+void Vector<T, Alloc, Growth>::Append(InputIt first, InputIt last) {
+  if constexpr (!std::is_base_of_v<std::forward_iterator_tag,
+                                   IteratorCategory<InputIt>>) {
+    for (; first != last; ++first) {
+      EmplaceBack(*first);
+    }
+  } else {
+    size_t count = std::distance(first, last);
+    if (count == 0) {
+      return;
+    }
+    if (begin_ + size_ + count > allocated_size_) {
+      if (size_ == 0 && count <= allocated_size_) {
+        begin_ = 0;
+      } else {
+        GrowWithGap(size_, count, [&](T* gap) {
+          ConstructRange(gap, first, count);
+        });
+        return;
+      }
+    }
+    ConstructRange(Data() + size_, first, count);
+    size_ += count;
+  }
+}
+
+// Если места в конце массива хватает, элементы после 'pos' сдвигаются
+// к концу (первые из них - в неинициализированную память), как в
+// std::vector. Вставка в самое начало использует запас перед элементами.
+template<typename T, typename Alloc, typename Growth>
+template<typename InputIt, typename>
+typename Vector<T, Alloc, Growth>::iterator
+Vector<T, Alloc, Growth>::Insert(const_iterator pos, InputIt first,
+                                 InputIt last) {
+  size_t position = pos - cbegin();
+  assert(position <= size_);
+  if constexpr (!std::is_base_of_v<std::forward_iterator_tag,
+                                   IteratorCategory<InputIt>>) {
+    // Однопроходный диапазон сначала сохраняется, чтобы узнать его длину.
+    Vector buffer(allocator_);
+    buffer.Append(first, last);
+    return Insert(pos, std::make_move_iterator(buffer.begin()),
+                  std::make_move_iterator(buffer.end()));
+  } else {
+    size_t count = std::distance(first, last);
+    if (count == 0) {
+      return begin() + position;
+    }
+    if (position == size_) {
+      Append(first, last);
+      return begin() + position;
+    }
+    if (position == 0 && begin_ >= count) {
+      ConstructRange(Data() - count, first, count);
+      begin_ -= count;
+      size_ += count;
+      return begin();
+    }
+    if (begin_ + size_ + count > allocated_size_) {
+      GrowWithGap(position, count, [&](T* gap) {
+        ConstructRange(gap, first, count);
+      });
+      return begin() + position;
+    }
+
+    T* data = Data();
+    T* old_end = data + size_;
+    size_t tail = size_ - position;
+    if (count <= tail) {
+      for (T* from = old_end - count; from != old_end; ++from) {
+        Construct(data + size_, std::move(*from));
+        ++size_;
+      }
+      std::move_backward(data + position, old_end - count, old_end);
+      std::copy(first, last, data + position);
+    } else {
+      InputIt middle = std::next(first, tail);
+      ConstructRange(old_end, middle, count - tail);
+      size_ += count - tail;
+      for (T* from = data + position; from != old_end; ++from) {
+        Construct(data + size_, std::move(*from));
+        ++size_;
+      }
+      std::copy(first, middle, data + position);
+    }
+    return data + position;
+  }
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::Resize(size_t size) {
+  ResizeWith(size);
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::Resize(size_t size, const T& value) {
+  ResizeWith(size, value);
+}
+
+template<typename T, typename Alloc, typename Growth>
+template<typename... Args>
+void Vector<T, Alloc, Growth>::ResizeWith(size_t size, const Args& ... args) {
+  if (size <= size_) {
+    Destroy(Data() + size, size_ - size);
+    size_ = size;
+    return;
+  }
+  size_t count = size - size_;
+  if (begin_ + size > allocated_size_) {
+    GrowWithGap(size_, count, [&](T* gap) {
+      ConstructFill(gap, count, args...);
+    });
+    return;
+  }
+  ConstructFill(Data() + size_, count, args...);
+  size_ = size;
+}
+
+template<typename T, typename Alloc, typename Growth>
+template<typename InputIt, typename>
+void Vector<T, Alloc, Growth>::Assign(InputIt first, InputIt last) {
+  Destroy(Data(), size_);
+  size_ = 0;
+  begin_ = 0;
+  Append(first, last);
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::Assign(size_t count, const T& value) {
+  if (std::less_equal<const T*>()(Data(), &value)
+      && std::less<const T*>()(&value, Data() + size_)) {
+    T copy(value);
+    Assign(count, copy);
+    return;
+  }
+  Destroy(Data(), size_);
+  size_ = 0;
+  begin_ = 0;
+  Resize(count, value);
+}
+
+template<typename T, typename Alloc, typename Growth>
+size_t Vector<T, Alloc, Growth>::Find(const T& value) const {
+  return FindEqual(Data(), size_, value);
+}
+
+template<typename T, typename Alloc, typename Growth>
+Vector<size_t> Vector<T, Alloc, Growth>::FindAll(const T& value) const {
+  Vector<size_t> positions;
+  const T* data = Data();
+  for (size_t pos = FindEqual(data, size_, value); pos != npos;) {
+    positions.PushBack(pos);
+    size_t next = FindEqual(data + pos + 1, size_ - pos - 1, value);
+    pos = next == npos ? npos : pos + 1 + next;
+  }
+  return positions;
+}
+
+template<typename T, typename Alloc, typename Growth>
+size_t Vector<T, Alloc, Growth>::Count(const T& value) const {
+  return CountEqual(Data(), size_, value);
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::Relocate(size_t new_size, size_t new_begin) {
+  assert(new_begin + size_ <= new_size);
+  T* new_data = Allocate(new_size);
+  try {
+    RelocateElements(Data(), size_, new_data + new_begin);
+  } catch (...) {
+    Deallocate(new_data, new_size);
+    throw;
+  }
+  Deallocate(data_, allocated_size_);
+  data_ = new_data;
+  allocated_size_ = new_size;
+  begin_ = new_begin;
+}
+
+template<typename T, typename Alloc, typename Growth>
+template<typename ConstructGap>
+void Vector<T, Alloc, Growth>::RelocateWithGap(size_t new_size,
+                                               size_t new_begin,
+                                               size_t position, size_t count,
+                                               ConstructGap construct_gap) {
+  assert(position <= size_);
+  assert(new_begin + size_ + count <= new_size);
+  T* new_data = Allocate(new_size);
+  T* gap = new_data + new_begin + position;
+  try {
+    construct_gap(gap);
+  } catch (...) {
+    Deallocate(new_data, new_size);
+    throw;
+  }
+  bool head_transferred = false;
+  try {
+    TransferElements(Data(), position, new_data + new_begin);
+    head_transferred = true;
+    TransferElements(Data() + position, size_ - position, gap + count);
+  } catch (...) {
+    if (head_transferred) {
+      Destroy(new_data + new_begin, position);
+    }
+    Destroy(gap, count);
+    Deallocate(new_data, new_size);
+    throw;
+  }
+  if constexpr (!kRelocateByMemcpy) {
+    Destroy(Data(), size_);
+  }
+  Deallocate(data_, allocated_size_);
+  data_ = new_data;
+  allocated_size_ = new_size;
+  begin_ = new_begin;
+  size_ += count;
+}
+
+// Вектор, в начало которого ничего не добавлялось (begin_ == 0), растёт
+// только в конец; иначе элементы размещаются по центру нового массива.
+template<typename T, typename Alloc, typename Growth>
+template<typename ConstructGap>
+void Vector<T, Alloc, Growth>::GrowWithGap(size_t position, size_t count,
+                                           ConstructGap construct_gap) {
+  size_t required = size_ + count;
+  if (begin_ == 0) {
+    RelocateWithGap(Growth::Grow(allocated_size_, required), 0, position,
+                    count, construct_gap);
+  } else {
+    size_t new_size = std::max(allocated_size_,
+                               Growth::Grow(size_, required));
+    RelocateWithGap(new_size, (new_size - required) / 2, position, count,
+                    construct_gap);
+  }
+}
+
+template<typename T, typename Alloc, typename Growth>
+template<typename ForwardIt>
+void Vector<T, Alloc, Growth>::ConstructRange(T* to, ForwardIt first,
+                                              size_t count) {
+  if constexpr (kRelocateByMemcpy && std::is_pointer_v<ForwardIt>
+      && std::is_same_v<std::remove_cv_t<std::remove_pointer_t<ForwardIt>>,
+                        T>) {
+    if (count != 0) {
+      std::memcpy(static_cast<void*>(to), first, count * sizeof(T));
+    }
+  } else {
+    size_t constructed = 0;
+    try {
+      for (; constructed < count; ++constructed, ++first) {
+        Construct(to + constructed, *first);
+      }
+    } catch (...) {
+      Destroy(to, constructed);
+      throw;
+    }
+  }
+}
+
+template<typename T, typename Alloc, typename Growth>
+template<typename... Args>
+void Vector<T, Alloc, Growth>::ConstructFill(T* to, size_t count,
+                                             const Args& ... args) {
+  // Нулевые байты - значение по умолчанию лишь для чисел, перечислений
+  // и указателей: нулевой указатель на член класса, например, в
+  // Itanium ABI представлен как -1.
+  if constexpr (sizeof...(Args) == 0 && kRelocateByMemcpy
+      && (std::is_arithmetic_v<T> || std::is_enum_v<T>
+          || std::is_pointer_v<T>)) {
+    if (count != 0) {
+      std::memset(static_cast<void*>(to), 0, count * sizeof(T));
+    }
+  } else {
+    size_t constructed = 0;
+    try {
+      for (; constructed < count; ++constructed) {
+        Construct(to + constructed, args...);
+      }
+    } catch (...) {
+      Destroy(to, constructed);
+      throw;
+    }
+  }
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::ShrinkIfSparse() {
+  size_t new_size = Growth::Shrink(allocated_size_, size_);
+  if (new_size == allocated_size_) {
+    return;
+  }
+  assert(size_ <= new_size && new_size < allocated_size_);
+  Relocate(new_size, begin_ == 0 ? 0 : (new_size - size_) / 2);
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::Release() {
+  Destroy(data_ + begin_, size_);
+  Deallocate(data_, allocated_size_);
+  size_ = 0;
+  allocated_size_ = 0;
+  begin_ = 0;
+  data_ = nullptr;
+}
+
+template<typename T, typename Alloc, typename Growth>
+T* Vector<T, Alloc, Growth>::Allocate(size_t count) {
+  if (count == 0) {
+    return nullptr;
+  }
+  return AllocTraits::allocate(allocator_, count);
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::Deallocate(T* data, size_t count) {
+  if (data != nullptr) {
+    AllocTraits::deallocate(allocator_, data, count);
+  }
+}
+
+template<typename T, typename Alloc, typename Growth>
+template<typename... Args>
+void Vector<T, Alloc, Growth>::Construct(T* place, Args&& ... args) {
+  AllocTraits::construct(allocator_, place, std::forward<Args>(args)...);
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::Destroy(T* data, size_t count) {
+  if constexpr (!std::is_trivially_destructible_v<T>
+      || !std::is_same_v<Alloc, std::allocator<T>>) {
+    for (size_t i = 0; i < count; ++i) {
+      AllocTraits::destroy(allocator_, data + i);
+    }
+  }
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::RelocateElements(T* from, size_t count, T* to) {
+  TransferElements(from, count, to);
+  if constexpr (!kRelocateByMemcpy) {
+    Destroy(from, count);
+  }
+}
+
+template<typename T, typename Alloc, typename Growth>
+void Vector<T, Alloc, Growth>::TransferElements(T* from, size_t count, T* to) {
+  if constexpr (kRelocateByMemcpy) {
+    if (count != 0) {
+      std::memcpy(static_cast<void*>(to), from, count * sizeof(T));
+    }
+  } else {
+    size_t constructed = 0;
+    try {
+      for (; constructed < count; ++constructed) {
+        Construct(to + constructed, std::move_if_noexcept(from[constructed]));
+      }
+    } catch (...) {
+      Destroy(to, constructed);
+      throw;
+    }
+  }
+}
+
+// Арена: выделяет память последовательно ("сдвигом указателя") из крупных
+// блоков и освобождает её только целиком - при вызове Reset или разрушении
+// арены. Подходит для множества короткоживущих объектов, которые умирают
+// одновременно, например в конце обработки запроса.
+class Arena {
+ public:
+  explicit Arena(size_t block_size = kDefaultBlockSize);
+  ~Arena();
+
+  Arena(const Arena& other) = delete;
+  Arena& operator=(const Arena& other) = delete;
+
+  // Выделяет 'bytes' байт, выровненных по 'alignment' (степень двойки).
+  void* Allocate(size_t bytes, size_t alignment);
+
+  // Освобождает всю выделенную ареной память. Один блок стандартного
+  // размера оставляется для повторного использования.
+  void Reset();
+
+  // Количество блоков, запрошенных у системы на данный момент.
+  size_t BlocksCount() const;
+
+ private:
+  static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+  // Заголовок блока; память блока следует сразу за ним.
+  struct alignas(std::max_align_t) Block {
+    Block* next;
+    size_t size;
+  };
+
+  size_t block_size_;
+  Block* blocks_;
+  char* current_;
+  char* end_;
+
+  // Добавляет в начало списка новый блок, вмещающий хотя бы 'min_bytes'.
+  void AddBlock(size_t min_bytes);
+};
+
+Arena::Arena(size_t block_size)
+    : block_size_(block_size),
+      blocks_(nullptr),
+      current_(nullptr),
+      end_(nullptr) {}
+
+Arena::~Arena() {
+  while (blocks_ != nullptr) {
+    Block* next = blocks_->next;
+    ::operator delete(blocks_);
+    blocks_ = next;
+  }
+}
+
+void* Arena::Allocate(size_t bytes, size_t alignment) {
+  auto aligned = [this, alignment] {
+    uintptr_t address = reinterpret_cast<uintptr_t>(current_);
+    return (address + alignment - 1) & ~(uintptr_t(alignment) - 1);
+  };
+  if (current_ == nullptr
+      || aligned() + bytes > reinterpret_cast<uintptr_t>(end_)) {
+    AddBlock(bytes + alignment);
+  }
+  char* result = reinterpret_cast<char*>(aligned());
+  current_ = result + bytes;
+  return result;
+}
+
+void Arena::Reset() {
+  Block* kept = nullptr;
+  while (blocks_ != nullptr) {
+    Block* next = blocks_->next;
+    if (kept == nullptr && blocks_->size == block_size_) {
+      kept = blocks_;
+      kept->next = nullptr;
+    } else {
+      ::operator delete(blocks_);
+    }
+    blocks_ = next;
+  }
+  blocks_ = kept;
+  if (kept != nullptr) {
+    current_ = reinterpret_cast<char*>(kept + 1);
+    end_ = current_ + kept->size;
+  } else {
+    current_ = nullptr;
+    end_ = nullptr;
+  }
+}
+
+size_t Arena::BlocksCount() const {
+  size_t count = 0;
+  for (Block* block = blocks_; block != nullptr; block = block->next) {
+    ++count;
+  }
+  return count;
+}
+
+void Arena::AddBlock(size_t min_bytes) {
+  size_t size = std::max(block_size_, min_bytes);
+  Block* block = static_cast<Block*>(::operator new(sizeof(Block) + size));
+  block->next = blocks_;
+  block->size = size;
+  blocks_ = block;
+  current_ = reinterpret_cast<char*>(block + 1);
+  end_ = current_ + size;
+}
+
+// Аллокатор, совместимый с std::allocator, берущий память из арены.
+// Освобождение отдельных элементов ничего не делает: память возвращается
+// системе вызовом Arena::Reset либо при разрушении арены.
+template<typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+
+  explicit ArenaAllocator(Arena* arena) noexcept : arena_(arena) {}
+
+  template<typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+      : arena_(other.GetArena()) {}
+
+  T* allocate(size_t count) {
+    if (count > std::numeric_limits<size_t>::max() / sizeof(T)) {
+      throw std::bad_array_new_length();
+    }
+    return static_cast<T*>(arena_->Allocate(count * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T*, size_t) noexcept {}
+
+  Arena* GetArena() const noexcept {
+    return arena_;
+  }
+
+  template<typename U>
+  bool operator==(const ArenaAllocator<U>& other) const noexcept {
+    return arena_ == other.GetArena();
+  }
+
+  template<typename U>
+  bool operator!=(const ArenaAllocator<U>& other) const noexcept {
+    return !(*this == other);
+  }
+
+ private:
+  Arena* arena_;
+};
+
+// Вектор с оптимизацией для малого числа элементов: первые 'N' элементов
+// хранятся прямо внутри объекта, и лишь при превышении этого размера
+// элементы переезжают в память, выделенную через 'Alloc'.
+// Интерфейс повторяет интерфейс Vector для операций с концом вектора.
+template<typename T, size_t N, typename Alloc = std::allocator<T>>
+class SmallVector {
+  static_assert(N > 0, "SmallVector needs room for at least one element");
+
+ public:
+  SmallVector() noexcept(noexcept(Alloc()));
+  explicit SmallVector(const Alloc& allocator) noexcept;
+
+  ~SmallVector();
+
+  // Аллокатор передаётся при присваивании по тем же правилам, что и у
+  // Vector (propagate_on_container_*_assignment).
+  SmallVector(const SmallVector& other);
+  SmallVector& operator=(const SmallVector& other);
+
+  // Если элементы 'other' лежат в куче, память забирается целиком;
+  // встроенные элементы перемещаются поштучно. Если аллокаторы не равны
+  // и не передаются, элементы из кучи тоже переносятся поштучно в новую
+  // память, поэтому такое присваивание может бросить исключение.
+  SmallVector(SmallVector&& other) noexcept(
+      std::is_nothrow_move_constructible_v<T>);
+  SmallVector& operator=(SmallVector&& other) noexcept(
+      std::is_nothrow_move_constructible_v<T>
+      && (std::allocator_traits<Alloc>::propagate_on_container_move_assignment
+              ::value
+          || std::allocator_traits<Alloc>::is_always_equal::value));
+
+  // Возвращает количество элементов в векторе.
+  size_t Size() const;
+
+  // Проверяет вектор на пустоту.
+  bool IsEmpty() const;
+
+  // Проверяет, хранятся ли элементы внутри объекта.
+  bool IsInline() const;
+
+  // Метод, добавлялющий элемент в конец вектора.
+  void PushBack(const T& value);
+
+  // Метод, удаляющий элемент с конца вектора.
+  void PopBack();
+
+  // оператор [], возращающий (неизменяемую) ссылку
+  // на объект по переданному индексу.
+  T& operator[](size_t ind);
+  const T& operator[](size_t ind) const;
+
+  // Метод, добавлялющий элемент в конец вектора и возвращающий ссылку
+  // на него. Элемент конструируется на месте.
+  template<typename... Args>
+  T& EmplaceBack(Args&& ... args);
+
+  // Значение, возвращаемое Find при отсутствии элемента.
+  static constexpr size_t npos = kNotFound;
+
+  // Метод, возвращающий позицию первого вхождения элемента в векторе
+  // либо npos, если элемент в векторе отстутствует.
+  size_t Find(const T& value) const;
+
+ protected:
+  using AllocTraits = std::allocator_traits<Alloc>;
+
+  // Количество элементов.
+  size_t size_;
+
+  // Размер массива data_; не меньше N.
+  size_t allocated_size_;
+
+  // Указатель либо на inline_data_, либо на память в куче.
+  T* data_;
+
+  [[no_unique_address]] Alloc allocator_;
+
+  // Встроенный буфер под N элементов.
+  alignas(T) unsigned char inline_data_[N * sizeof(T)];
+
+  T* InlineData();
+
+  // Переносит элементы в кучу, в массив размера 'new_size', и
+  // конструирует из 'args' новый элемент после последнего.
+  template<typename... Args>
+  void RelocateAndEmplaceBack(size_t new_size, Args&& ... args);
+
+  // Заменяет элементы данного вектора копиями элементов 'other', не
+  // меняя аллокатор.
+  void CopyFrom(const SmallVector& other);
+
+  // Переносит элементы из 'other' в данный (пустой) вектор.
+  void StealFrom(SmallVector& other);
+
+  // Разрушает все элементы и возвращается во встроенный буфер.
+  void Release();
+
+  void Destroy(T* data, size_t count);
+};
 
-template<typename T>
-Vector<T>::~Vector() {
-  delete[] data_;
+template<typename T, size_t N, typename Alloc>
+SmallVector<T, N, Alloc>::SmallVector() noexcept(noexcept(Alloc()))
+    : size_(0),
+      allocated_size_(N),
+      data_(InlineData()),
+      allocator_() {}
+
+template<typename T, size_t N, typename Alloc>
+SmallVector<T, N, Alloc>::SmallVector(const Alloc& allocator) noexcept
+    : size_(0),
+      allocated_size_(N),
+      data_(InlineData()),
+      allocator_(allocator) {}
+
+template<typename T, size_t N, typename Alloc>
+SmallVector<T, N, Alloc>::~SmallVector() {
+  Release();
 }
 
-template<typename T>
-Vector<T>::Vector(const Vector& other)
-    : size_(other.size_),
-      allocated_size_(other.allocated_size_),
-      data_(new T[allocated_size_]) {
-  for (size_t i = 0; i < size_; ++i) {
-    data_[i] = other.data_[i];
-  }
+template<typename T, size_t N, typename Alloc>
+SmallVector<T, N, Alloc>::SmallVector(const SmallVector& other)
+    : SmallVector(AllocTraits::select_on_container_copy_construction(
+          other.allocator_)) {
+  CopyFrom(other);
 }
 
-template<typename T>
-Vector<T>& Vector<T>::operator=(const Vector& other) {
-  if (allocated_size_ != other.allocated_size_) {
-    allocated_size_ = other.allocated_size_;
-    delete[] data_;
-    data_ = new T[allocated_size_];
+template<typename T, size_t N, typename Alloc>
+SmallVector<T, N, Alloc>& SmallVector<T, N, Alloc>::operator=(
+    const SmallVector& other) {
+  if (this == &other) {
+    return *this;
   }
-  size_ = other.size_;
-  for (size_t i = 0; i < size_; ++i) {
-    data_[i] = other.data_[i];
+  if constexpr (AllocTraits::propagate_on_container_copy_assignment::value) {
+    if (allocator_ != other.allocator_) {
+      // Память из кучи освобождается прежним аллокатором.
+      Release();
+    }
+    allocator_ = other.allocator_;
   }
+  CopyFrom(other);
   return *this;
 }
 
-template<typename T>
-Vector<T>::Vector(Vector&& other) noexcept
-    : size_(other.size_),
-      allocated_size_(other.allocated_size_),
-      data_(other.data_) {
-  other.size_ = 0;
-  other.allocated_size_ = 1;
-  other.data_ = new T[1];
+template<typename T, size_t N, typename Alloc>
+void SmallVector<T, N, Alloc>::CopyFrom(const SmallVector& other) {
+  Destroy(data_, size_);
+  size_ = 0;
+  if (allocated_size_ < other.size_) {
+    T* new_data = AllocTraits::allocate(allocator_, other.size_);
+    Release();
+    data_ = new_data;
+    allocated_size_ = other.size_;
+  }
+  for (; size_ < other.size_; ++size_) {
+    AllocTraits::construct(allocator_, data_ + size_, other.data_[size_]);
+  }
 }
 
-template<typename T>
-Vector<T>& Vector<T>::operator=(Vector&& other) noexcept {
-  delete[] data_;
-  size_ = other.size_;
-  allocated_size_ = other.allocated_size_;
-  data_ = other.data_;
+template<typename T, size_t N, typename Alloc>
+SmallVector<T, N, Alloc>::SmallVector(SmallVector&& other) noexcept(
+    std::is_nothrow_move_constructible_v<T>)
+    : SmallVector(other.allocator_) {
+  StealFrom(other);
+}
 
-  other.size_ = 0;
-  other.allocated_size_ = 1;
-  other.data_ = new T[1];
+template<typename T, size_t N, typename Alloc>
+SmallVector<T, N, Alloc>& SmallVector<T, N, Alloc>::operator=(
+    SmallVector&& other) noexcept(
+    std::is_nothrow_move_constructible_v<T>
+    && (std::allocator_traits<Alloc>::propagate_on_container_move_assignment
+            ::value
+        || std::allocator_traits<Alloc>::is_always_equal::value)) {
+  if (this == &other) {
+    return *this;
+  }
+  Release();
+  if constexpr (AllocTraits::propagate_on_container_move_assignment::value) {
+    // Аллокатор копируется: встроенные элементы 'other' ещё разрушаются им.
+    allocator_ = other.allocator_;
+  }
+  StealFrom(other);
   return *this;
 }
 
-template<typename T>
-size_t Vector<T>::Size() const {
+template<typename T, size_t N, typename Alloc>
+size_t SmallVector<T, N, Alloc>::Size() const {
   return size_;
 }
 
-template<typename T>
-bool Vector<T>::IsEmpty() const {
+template<typename T, size_t N, typename Alloc>
+bool SmallVector<T, N, Alloc>::IsEmpty() const {
   return size_ == 0;
 }
 
-template<typename T>
-void Vector<T>::PushBack(const T& value) {
-  if (size_ == allocated_size_) {
-    Relocate(size_ * 2);
-  }
-  data_[size_++] = value;
-}
-
-template<typename T>
-void Vector<T>::PopBack() {
-  assert(size_ != 0);
-  --size_;
-  if (size_ < allocated_size_ / 4) {
-    Relocate(allocated_size_ / 2);
-  }
+template<typename T, size_t N, typename Alloc>
+bool SmallVector<T, N, Alloc>::IsInline() const {
+  return allocated_size_ == N;
 }
 
-template<typename T>
-void Vector<T>::PushFront(const T& value) {
-  if (size_ == allocated_size_) {
-    Relocate(size_ * 2);
-  }
-  ++size_;
-  for (size_t i = size_; i > 1; --i) {
-    data_[i - 1] = data_[i - 2];
-  }
-  data_[0] = value;
+template<typename T, size_t N, typename Alloc>
+void SmallVector<T, N, Alloc>::PushBack(const T& value) {
+  EmplaceBack(value);
 }
 
-template<typename T>
-void Vector<T>::PopFront() {
+template<typename T, size_t N, typename Alloc>
+void SmallVector<T, N, Alloc>::PopBack() {
   assert(size_ != 0);
-  for (size_t i = 0; i < size_ - 1; ++i) {
-    data_[i] = data_[i + 1];
-  }
   --size_;
-  if (size_ < allocated_size_ / 4) {
-    Relocate(allocated_size_ / 2);
-  }
+  Destroy(data_ + size_, 1);
 }
 
-template<typename T>
-T const& Vector<T>::operator[](size_t ind) const {
+template<typename T, size_t N, typename Alloc>
+T& SmallVector<T, N, Alloc>::operator[](size_t ind) {
   assert(ind < size_);
   return data_[ind];
 }
 
-template<typename T>
-T& Vector<T>::operator[](size_t ind) {
+template<typename T, size_t N, typename Alloc>
+const T& SmallVector<T, N, Alloc>::operator[](size_t ind) const {
   assert(ind < size_);
   return data_[ind];
 }
 
-template<typename T>
+template<typename T, size_t N, typename Alloc>
 template<typename... Args>
-void Vector<T>::EmplaceBack(Args&& ... args) {
+T& SmallVector<T, N, Alloc>::EmplaceBack(Args&& ... args) {
   if (size_ == allocated_size_) {
-    Relocate(size_ * 2);
+    RelocateAndEmplaceBack(size_ * 2, std::forward<Args>(args)...);
+  } else {
+    AllocTraits::construct(allocator_, data_ + size_,
+                           std::forward<Args>(args)...);
+    ++size_;
   }
-  data_[size_++] = T(std::forward<Args>(args)...);
+  return data_[size_ - 1];
 }
 
-template<typename T>
+template<typename T, size_t N, typename Alloc>
+size_t SmallVector<T, N, Alloc>::Find(const T& value) const {
+  return FindEqual(data_, size_, value);
+}
+
+template<typename T, size_t N, typename Alloc>
+T* SmallVector<T, N, Alloc>::InlineData() {
+  return std::launder(reinterpret_cast<T*>(inline_data_));
+}
+
+template<typename T, size_t N, typename Alloc>
 template<typename... Args>
-void Vector<T>::EmplaceFront(Args&& ... args) {
-  if (size_ == allocated_size_) {
-    Relocate(size_ * 2);
+void SmallVector<T, N, Alloc>::RelocateAndEmplaceBack(size_t new_size,
+                                                      Args&& ... args) {
+  T* new_data = AllocTraits::allocate(allocator_, new_size);
+  bool emplaced = false;
+  size_t constructed = 0;
+  try {
+    AllocTraits::construct(allocator_, new_data + size_,
+                           std::forward<Args>(args)...);
+    emplaced = true;
+    for (; constructed < size_; ++constructed) {
+      AllocTraits::construct(allocator_, new_data + constructed,
+                             std::move_if_noexcept(data_[constructed]));
+    }
+  } catch (...) {
+    Destroy(new_data, constructed);
+    if (emplaced) {
+      Destroy(new_data + size_, 1);
+    }
+    AllocTraits::deallocate(allocator_, new_data, new_size);
+    throw;
   }
-  ++size_;
-  for (size_t i = size_; i > 1; --i) {
-    data_[i - 1] = data_[i - 2];
+  size_t size = size_ + 1;
+  Release();
+  data_ = new_data;
+  allocated_size_ = new_size;
+  size_ = size;
+}
+
+template<typename T, size_t N, typename Alloc>
+void SmallVector<T, N, Alloc>::StealFrom(SmallVector& other) {
+  assert(size_ == 0 && IsInline());
+  if (!other.IsInline() && allocator_ == other.allocator_) {
+    data_ = other.data_;
+    allocated_size_ = other.allocated_size_;
+    size_ = other.size_;
+    other.data_ = other.InlineData();
+    other.allocated_size_ = N;
+    other.size_ = 0;
+    return;
+  }
+  if (other.size_ > N) {
+    data_ = AllocTraits::allocate(allocator_, other.size_);
+    allocated_size_ = other.size_;
   }
-  data_[0] = T(std::forward<Args>(args)...);
+  for (; size_ < other.size_; ++size_) {
+    AllocTraits::construct(allocator_, data_ + size_,
+                           std::move(other.data_[size_]));
+  }
+  other.Release();
 }
 
-template<typename T>
-int Vector<T>::Find(const T& value) const {
-  for (size_t i = 0; i < size_; ++i) {
-    if (data_[i] == value) {
-      return i;
-    }
+template<typename T, size_t N, typename Alloc>
+void SmallVector<T, N, Alloc>::Release() {
+  Destroy(data_, size_);
+  if (!IsInline()) {
+    AllocTraits::deallocate(allocator_, data_, allocated_size_);
   }
-  return -1;
+  data_ = InlineData();
+  allocated_size_ = N;
+  size_ = 0;
 }
 
-template<typename T>
-void Vector<T>::Relocate(size_t new_size) {
-  allocated_size_ = new_size;
-  T* tmp = data_;
-  data_ = new T[allocated_size_];
-  for (size_t i = 0; i < size_; ++i) {
-    data_[i] = tmp[i];
+template<typename T, size_t N, typename Alloc>
+void SmallVector<T, N, Alloc>::Destroy(T* data, size_t count) {
+  if constexpr (!std::is_trivially_destructible_v<T>
+      || !std::is_same_v<Alloc, std::allocator<T>>) {
+    for (size_t i = 0; i < count; ++i) {
+      AllocTraits::destroy(allocator_, data + i);
+    }
   }
-  delete[] tmp;
 }
 
 #ifndef IGNORE_MAIN
+// Возвращает время выполнения 'func' в миллисекундах.
+template<typename Func>
+double MeasureMilliseconds(Func func) {
+  auto start = std::chrono::steady_clock::now();
+  func();
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+// Аллокатор, подсчитывающий число выделений памяти.
+template<typename T>
+class CountingAllocator {
+ public:
+  using value_type = T;
+
+  inline static size_t allocations = 0;
+
+  CountingAllocator() = default;
+  template<typename U>
+  CountingAllocator(const CountingAllocator<U>&) noexcept {}
+
+  T* allocate(size_t count) {
+    ++allocations;
+    return std::allocator<T>().allocate(count);
+  }
+  void deallocate(T* data, size_t count) noexcept {
+    std::allocator<T>().deallocate(data, count);
+  }
+
+  template<typename U>
+  bool operator==(const CountingAllocator<U>&) const noexcept {
+    return true;
+  }
+  template<typename U>
+  bool operator!=(const CountingAllocator<U>&) const noexcept {
+    return false;
+  }
+};
+
+// Элемент, подсчитывающий вызовы своих конструкторов,
+// операторов присваивания и деструкторов.
+struct InstrumentedElement {
+  inline static size_t default_constructions = 0;
+  inline static size_t value_constructions = 0;
+  inline static size_t copy_constructions = 0;
+  inline static size_t move_constructions = 0;
+  inline static size_t assignments = 0;
+  inline static size_t destructions = 0;
+
+  static void ResetCounters() {
+    default_constructions = 0;
+    value_constructions = 0;
+    copy_constructions = 0;
+    move_constructions = 0;
+    assignments = 0;
+    destructions = 0;
+  }
+
+  int value;
+
+  InstrumentedElement() : value(0) {
+    ++default_constructions;
+  }
+  explicit InstrumentedElement(int value) : value(value) {
+    ++value_constructions;
+  }
+  InstrumentedElement(const InstrumentedElement& other) : value(other.value) {
+    ++copy_constructions;
+  }
+  InstrumentedElement(InstrumentedElement&& other) noexcept
+      : value(other.value) {
+    ++move_constructions;
+  }
+  InstrumentedElement& operator=(const InstrumentedElement& other) {
+    value = other.value;
+    ++assignments;
+    return *this;
+  }
+  InstrumentedElement& operator=(InstrumentedElement&& other) noexcept {
+    value = other.value;
+    ++assignments;
+    return *this;
+  }
+  ~InstrumentedElement() {
+    ++destructions;
+  }
+};
+
+// Элемент, копирующий конструктор которого бросает исключение
+// после 'copies_before_throw' успешных копирований.
+struct ThrowingElement {
+  inline static int copies_before_throw = -1;
+
+  std::string value;
+
+  explicit ThrowingElement(std::string value) : value(std::move(value)) {}
+  ThrowingElement(const ThrowingElement& other) : value(other.value) {
+    if (copies_before_throw == 0) {
+      throw std::runtime_error("copy failed");
+    }
+    --copies_before_throw;
+  }
+  ThrowingElement(ThrowingElement&&) noexcept = default;
+  ThrowingElement& operator=(const ThrowingElement&) = default;
+};
+
 int main() {
 #ifndef SKIP_BASIC
   {
@@ -271,6 +1834,7 @@ int main() {
     const Vector<int>& const_v = v;
 
     assert(const_v.Size() == 0 && const_v.IsEmpty());
+    assert(VectorInternalsAccessor<int>::AllocData(v) == nullptr);
 
     v.PushBack(42);
     assert(const_v.Size() == 1 && !const_v.IsEmpty());
@@ -296,7 +1860,7 @@ int main() {
 #ifndef SKIP_RELOC
   {
     Vector<int> v;
-    assert(VectorInternalsAccessor<int>::AllocSize(v) == 1);
+    assert(VectorInternalsAccessor<int>::AllocSize(v) == 0);
     for (int i = 0; i < 1025; ++i) {
       v.PushBack(i);
     }
@@ -305,6 +1869,29 @@ int main() {
       assert(v[i] == i);
     }
   }
+  {
+    InstrumentedElement::ResetCounters();
+    {
+      Vector<InstrumentedElement> v;
+      for (int i = 0; i < 1025; ++i) {
+        v.EmplaceBack(i);
+      }
+      for (int i = 0; i < 1025; ++i) {
+        assert(v[i].value == i);
+      }
+
+      // Ни одного конструктора для пустых слотов и ни одной копии
+      // при переездах: только перемещения уже существующих элементов
+      // (1 + 2 + ... + 1024 при росте ёмкости от 1 до 2048).
+      assert(InstrumentedElement::default_constructions == 0);
+      assert(InstrumentedElement::value_constructions == 1025);
+      assert(InstrumentedElement::copy_constructions == 0);
+      assert(InstrumentedElement::move_constructions == 2047);
+      assert(InstrumentedElement::assignments == 0);
+      assert(InstrumentedElement::destructions == 2047);
+    }
+    assert(InstrumentedElement::destructions == 2047 + 1025);
+  }
   std::cout << "[PASS] Relocation" << std::endl;
 #else
   std::cout << "[SKIPPED] Relocation" << std::endl;
@@ -342,6 +1929,62 @@ int main() {
   std::cout << "[SKIPPED] XFront" << std::endl;
 #endif  // SKIP_XFRONT
 
+#ifndef SKIP_DEQUE
+  {
+    Vector<int> v;
+    for (int i = 0; i < 1000; ++i) {
+      v.PushFront(-i - 1);
+      v.PushBack(i);
+    }
+    assert(v.Size() == 2000);
+    for (int i = 0; i < 2000; ++i) {
+      assert(v[i] == i - 1000);
+    }
+    assert(v.Find(-1000) == 0);
+    assert(v.Find(999) == 1999);
+    assert(VectorInternalsAccessor<int>::AllocSize(v) >= v.Size());
+
+    // Очередь: кладём в конец, забираем из начала.
+    for (int i = 0; i < 100'000; ++i) {
+      v.PushBack(i + 1000);
+      assert(v[0] == i - 1000);
+      v.PopFront();
+    }
+    assert(v.Size() == 2000);
+    for (int i = 0; i < 2000; ++i) {
+      assert(v[i] == 99'000 + i);
+    }
+    assert(VectorInternalsAccessor<int>::AllocSize(v) <= 8 * v.Size());
+
+    while (!v.IsEmpty()) {
+      v.PopFront();
+      if (!v.IsEmpty()) {
+        v.PopBack();
+      }
+    }
+    v.PushFront(1);
+    v.PushBack(2);
+    assert(v.Size() == 2 && v[0] == 1 && v[1] == 2);
+  }
+  {
+    Vector<std::string> v;
+    for (int i = 0; i < 100; ++i) {
+      v.PushFront(std::to_string(i));
+    }
+    Vector<std::string> other(v);
+    v.PopFront();
+    other.PushFront("front");
+    for (int i = 0; i < 99; ++i) {
+      assert(v[i] == std::to_string(98 - i));
+      assert(other[i + 2] == v[i]);
+    }
+    assert(other[0] == "front" && other[1] == "99");
+  }
+  std::cout << "[PASS] Deque" << std::endl;
+#else
+  std::cout << "[SKIPPED] Deque" << std::endl;
+#endif  // SKIP_DEQUE
+
 #ifndef SKIP_FIND
   {
     Vector<int> v;
@@ -354,7 +1997,67 @@ int main() {
     assert(const_v.Find(0) == 0);
     assert(const_v.Find(1) == 1);
     assert(const_v.Find(2) == 2);
-    assert(const_v.Find(3) == -1);
+    assert(const_v.Find(3) == Vector<int>::npos);
+    assert(const_v.Count(1) == 2 && const_v.Count(3) == 0);
+    Vector<size_t> ones = const_v.FindAll(1);
+    assert(ones.Size() == 2 && ones[0] == 1 && ones[1] == 3);
+  }
+  {
+    // Векторизованный поиск сверяется с поэлементным для всех длин
+    // и позиций, включая хвосты короче одного SIMD-блока.
+    auto check = [](auto sample) {
+      using Element = decltype(sample);
+      Vector<Element> v;
+      for (int size = 0; size < 100; ++size) {
+        for (int i = 0; i < size; ++i) {
+          assert(v.Find(v[i]) == FindEqualScalar(&v[0], v.Size(), v[i]));
+          assert(v.Count(v[i]) == CountEqualScalar(&v[0], v.Size(), v[i]));
+#ifdef VECTOR_SIMD_X86
+          // Ветка SSE2 проверяется явно, даже если процессор умеет AVX2.
+          assert(Sse2FindEqual(&v[0], v.Size(), v[i]) == v.Find(v[i]));
+          assert(Sse2CountEqual(&v[0], v.Size(), v[i]) == v.Count(v[i]));
+#endif  // VECTOR_SIMD_X86
+        }
+        Element missing = static_cast<Element>(size % 2 == 0 ? 101 : 103);
+        assert(v.Find(missing) == Vector<Element>::npos);
+        assert(v.Count(missing) == 0);
+        v.PushBack(static_cast<Element>(size % 37));
+      }
+      assert(v.FindAll(static_cast<Element>(5)).Size()
+                 == v.Count(static_cast<Element>(5)));
+    };
+    check(char());
+    check(short());
+    check(int());
+    check(int64_t());
+    check(float());
+    check(double());
+
+    // Семантика ==: NaN не равен ничему, нули разного знака равны.
+    Vector<double> v;
+    v.PushBack(std::numeric_limits<double>::quiet_NaN());
+    v.PushBack(1.0);
+    v.PushBack(-0.0);
+    for (int i = 0; i < 10; ++i) {
+      v.PushBack(2.0);
+    }
+    assert(v.Find(std::numeric_limits<double>::quiet_NaN())
+               == Vector<double>::npos);
+    assert(v.Find(0.0) == 2);
+    assert(v.Count(2.0) == 10);
+
+    // Старшие половины 64-битных чисел тоже сравниваются.
+    Vector<int64_t> wide;
+    for (int i = 0; i < 8; ++i) {
+      wide.PushBack((int64_t(i) << 32) | 7);
+    }
+    assert(wide.Find(7) == 0 && wide.Count(7) == 1);
+    assert(wide.Find((int64_t(5) << 32) | 7) == 5);
+
+    Vector<std::string> strings;
+    strings.PushBack("a");
+    strings.PushBack("b");
+    assert(strings.Find("b") == 1 && strings.Count("c") == 0);
   }
   std::cout << "[PASS] Find" << std::endl;
 #else
@@ -386,6 +2089,47 @@ int main() {
     assert(v[4].i_field == 0 && v[4].s_field == "<EMPTY>");
     assert(v[5].i_field == 42 && v[5].s_field == "4242");
   }
+  {
+    // Каждый Emplace* должен вызывать ровно один конструктор нового
+    // элемента и ни одного присваивания; перемещения допустимы лишь
+    // при переезде в новый массив.
+    InstrumentedElement::ResetCounters();
+    using Accessor = VectorInternalsAccessor<InstrumentedElement>;
+    Vector<InstrumentedElement> v;
+    size_t relocated = 0;
+    for (int i = 0; i < 300; ++i) {
+      size_t old_size = v.Size();
+      size_t old_alloc = Accessor::AllocSize(v);
+      size_t old_moves = InstrumentedElement::move_constructions;
+      InstrumentedElement& element =
+          (i % 3 == 0) ? v.EmplaceFront(i) : v.EmplaceBack(i);
+      assert(&element == &v[(i % 3 == 0) ? 0 : v.Size() - 1]);
+      assert(element.value == i);
+      assert(InstrumentedElement::value_constructions == size_t(i) + 1);
+      assert(InstrumentedElement::default_constructions == 0);
+      assert(InstrumentedElement::copy_constructions == 0);
+      assert(InstrumentedElement::assignments == 0);
+      if (Accessor::AllocSize(v) == old_alloc) {
+        assert(InstrumentedElement::move_constructions == old_moves);
+      } else {
+        relocated += old_size;
+      }
+    }
+    assert(InstrumentedElement::move_constructions == relocated);
+  }
+  {
+    // Аргументы могут ссылаться на элементы самого вектора,
+    // даже если для вставки требуется переезд.
+    Vector<std::string> v;
+    v.EmplaceBack(100, 'a');
+    for (int i = 0; i < 10; ++i) {
+      v.EmplaceBack(v[0]);
+      v.EmplaceFront(v[v.Size() - 1]);
+    }
+    for (size_t i = 0; i < v.Size(); ++i) {
+      assert(v[i] == std::string(100, 'a'));
+    }
+  }
   std::cout << "[PASS] Empalce" << std::endl;
 #else
   std::cout << "[SKIPPED] Empalce" << std::endl;
@@ -491,7 +2235,8 @@ int main() {
     assert(v.Size() == 0);
     assert(VectorInternalsAccessor<int>::AllocData(v)
                != VectorInternalsAccessor<int>::AllocData(other));
-    assert(VectorInternalsAccessor<int>::AllocSize(v) == 1);
+    assert(VectorInternalsAccessor<int>::AllocData(v) == nullptr);
+    assert(VectorInternalsAccessor<int>::AllocSize(v) == 0);
   }
   {
     Vector<int> v;
@@ -514,13 +2259,705 @@ int main() {
     assert(VectorInternalsAccessor<int>::AllocData(v)
                != VectorInternalsAccessor<int>::AllocData(other));
     assert(VectorInternalsAccessor<int>::AllocData(v) != other_intitial_data);
-    assert(VectorInternalsAccessor<int>::AllocSize(v) == 1);
+    assert(VectorInternalsAccessor<int>::AllocData(v) == nullptr);
+    assert(VectorInternalsAccessor<int>::AllocSize(v) == 0);
   }
   std::cout << "[PASS] Move" << std::endl;
 #else
   std::cout << "[SKIPPED] Move" << std::endl;
 #endif  // SKIP_MOVE
 
+#ifndef SKIP_ASSIGN
+  {
+    // Перемещения и обмены не выделяют память; копирующее присваивание
+    // в вектор достаточной ёмкости тоже.
+    using Counted = Vector<int, CountingAllocator<int>>;
+    Counted a;
+    Counted b;
+    for (int i = 0; i < 100; ++i) {
+      a.PushBack(i);
+    }
+    CountingAllocator<int>::allocations = 0;
+    for (int i = 0; i < 1000; ++i) {
+      Counted moved(std::move(a));
+      assert(a.IsEmpty() && a.Capacity() == 0);
+      b = std::move(moved);
+      b.Swap(a);
+    }
+    assert(CountingAllocator<int>::allocations == 0);
+    assert(a.Size() == 100 && b.IsEmpty());
+
+    const int* data = nullptr;
+    for (int i = 0; i < 1000; ++i) {
+      b = a;
+      if (i == 0) {
+        data = b.Data();
+      }
+      assert(b.Data() == data && b.Size() == 100 && b[99] == 99);
+    }
+    assert(CountingAllocator<int>::allocations == 1);
+
+    Counted copy(a);
+    assert(copy.Capacity() == 100);
+    assert(CountingAllocator<int>::allocations == 2);
+    Counted small;
+    small.PushBack(1);
+    copy = small;
+    assert(copy.Size() == 1 && copy.Capacity() == 100);
+    assert(CountingAllocator<int>::allocations == 3);
+  }
+  {
+    // Строгая гарантия: при исключении во время копирования
+    // вектор-приёмник не меняется.
+    Vector<ThrowingElement> source;
+    Vector<ThrowingElement> target;
+    for (int i = 0; i < 10; ++i) {
+      source.EmplaceBack(std::to_string(i));
+      target.EmplaceBack("old" + std::to_string(i));
+    }
+    target.PopBack();
+    const ThrowingElement* target_data = target.Data();
+
+    ThrowingElement::copies_before_throw = 5;
+    bool thrown = false;
+    try {
+      target = source;
+    } catch (const std::runtime_error&) {
+      thrown = true;
+    }
+    ThrowingElement::copies_before_throw = -1;
+    assert(thrown);
+    assert(target.Size() == 9 && target.Data() == target_data);
+    for (int i = 0; i < 9; ++i) {
+      assert(target[i].value == "old" + std::to_string(i));
+    }
+    target = source;
+    assert(target.Size() == 10 && target[9].value == "9");
+  }
+  std::cout << "[PASS] Assign" << std::endl;
+#else
+  std::cout << "[SKIPPED] Assign" << std::endl;
+#endif  // SKIP_ASSIGN
+
+#ifndef SKIP_ALLOCATOR
+  {
+    Arena arena(1024);
+    {
+      using StringAllocator = ArenaAllocator<std::string>;
+      Vector<std::string, StringAllocator> v{StringAllocator(&arena)};
+      assert(arena.BlocksCount() == 0);
+      for (int i = 0; i < 100; ++i) {
+        v.PushBack(std::to_string(i));
+        v.PushFront(std::to_string(-i));
+      }
+      assert(arena.BlocksCount() > 0);
+      assert(v.GetAllocator().GetArena() == &arena);
+
+      Vector<std::string, StringAllocator> copy(v);
+      Vector<std::string, StringAllocator> moved(std::move(copy));
+      assert(copy.IsEmpty());
+      for (int i = 0; i < 100; ++i) {
+        assert(moved[99 - i] == std::to_string(-i));
+        assert(moved[100 + i] == std::to_string(i));
+      }
+
+      // Векторы из разных арен: перемещающее присваивание забирает
+      // аллокатор вместе с памятью.
+      Arena other_arena;
+      Vector<std::string, StringAllocator> other{StringAllocator(&other_arena)};
+      other.PushBack("other");
+      other = std::move(moved);
+      assert(other.GetAllocator().GetArena() == &arena);
+      assert(other.Size() == 200 && other[0] == "-99");
+    }
+    arena.Reset();
+    assert(arena.BlocksCount() <= 1);
+
+    Vector<int, ArenaAllocator<int>> v{ArenaAllocator<int>(&arena)};
+    for (int i = 0; i < 10'000; ++i) {
+      v.PushBack(i);
+    }
+    for (int i = 0; i < 10'000; ++i) {
+      assert(v[i] == i);
+    }
+    assert(v.Find(9'999) == 9'999);
+  }
+  std::cout << "[PASS] Allocator" << std::endl;
+#else
+  std::cout << "[SKIPPED] Allocator" << std::endl;
+#endif  // SKIP_ALLOCATOR
+
+#ifndef SKIP_GROWTH
+  {
+    Vector<int, std::allocator<int>, HalfGrowth> v;
+    std::vector<size_t> capacities;
+    for (int i = 0; i < 20; ++i) {
+      v.PushBack(i);
+      if (capacities.empty() || capacities.back() != v.Capacity()) {
+        capacities.push_back(v.Capacity());
+      }
+    }
+    assert(capacities == std::vector<size_t>({1, 2, 3, 4, 6, 9, 13, 19, 28}));
+  }
+  {
+    Vector<int, std::allocator<int>, FixedChunkGrowth<100>> v;
+    for (int i = 0; i < 250; ++i) {
+      v.PushBack(i);
+    }
+    assert(v.Capacity() == 300);
+    while (v.Size() > 50) {
+      v.PopBack();
+    }
+    assert(v.Capacity() == 200);
+  }
+  {
+    Vector<int, std::allocator<int>, NoAutoShrink<DoublingGrowth>> v;
+    for (int i = 0; i < 1000; ++i) {
+      v.PushBack(i);
+    }
+    while (!v.IsEmpty()) {
+      v.PopFront();
+    }
+    assert(v.Capacity() == 1024);
+    v.ShrinkToFit();
+    assert(v.Capacity() == 0);
+  }
+  {
+    Vector<int> v;
+    v.Reserve(100);
+    const int* data = VectorInternalsAccessor<int>::AllocData(v);
+    for (int i = 0; i < 100; ++i) {
+      v.PushBack(i);
+    }
+    assert(v.Capacity() == 100);
+    assert(VectorInternalsAccessor<int>::AllocData(v) == data);
+    v.Reserve(10);
+    assert(v.Capacity() == 100);
+    v.PushBack(100);
+    v.ShrinkToFit();
+    assert(v.Capacity() == 101);
+    for (int i = 0; i <= 100; ++i) {
+      assert(v[i] == i);
+    }
+  }
+  {
+    // После вставок в начало ёмкость не включает запас перед элементами.
+    Vector<int> v;
+    for (int i = 0; i < 10; ++i) {
+      v.PushFront(i);
+    }
+    const int* data = v.Data();
+    while (v.Size() < v.Capacity()) {
+      v.PushBack(0);
+    }
+    assert(v.Data() == data);
+
+    Vector<int> reserved;
+    for (int i = 0; i < 10; ++i) {
+      reserved.PushFront(i);
+    }
+    // Массив вмещает запрошенное число элементов, но не позади них.
+    size_t total = VectorInternalsAccessor<int>::AllocSize(reserved);
+    assert(reserved.Capacity() < total);
+    reserved.Reserve(total);
+    assert(reserved.Capacity() >= total);
+    data = reserved.Data();
+    while (reserved.Size() < total) {
+      reserved.PushBack(-1);
+    }
+    assert(reserved.Data() == data && reserved[0] == 9 && reserved[9] == 0);
+  }
+  std::cout << "[PASS] Growth" << std::endl;
+#else
+  std::cout << "[SKIPPED] Growth" << std::endl;
+#endif  // SKIP_GROWTH
+
+#ifndef SKIP_ITERATORS
+  {
+    Vector<int> v;
+    for (int i = 0; i < 10; ++i) {
+      v.PushFront(i);
+    }
+    int expected = 9;
+    for (int value : v) {
+      assert(value == expected--);
+    }
+    assert(v.end() - v.begin() == 10);
+    assert(v.Data() == &v[0] && v.cbegin() == v.begin());
+
+    std::sort(v.begin(), v.end());
+    assert(std::is_sorted(v.begin(), v.end()));
+    std::transform(v.begin(), v.end(), v.begin(),
+                   [](int value) { return value * value; });
+    assert(std::accumulate(v.cbegin(), v.cend(), 0) == 285);
+    assert(*std::find(v.begin(), v.end(), 49) == 49);
+
+    const Vector<int>& const_v = v;
+    std::vector<int> copy(const_v.begin(), const_v.end());
+    assert(copy.size() == 10 && copy[3] == 9);
+
+    Vector<int> empty;
+    assert(empty.begin() == empty.end());
+    for ([[maybe_unused]] int value : empty) {
+      assert(false);
+    }
+  }
+#ifdef WITH_PARALLEL_STL
+  {
+    // Параллельная сортировка прямо на памяти вектора, без копирования
+    // в std::vector. С libstdc++ параллельные алгоритмы работают поверх
+    // TBB, поэтому тест включается отдельно:
+    //   g++ -std=c++17 -O2 -DWITH_PARALLEL_STL main.cpp -ltbb
+    const int kElementsCount = 50'000'000;
+    Vector<int> v;
+    v.Reserve(kElementsCount);
+    uint32_t state = 2018;
+    for (int i = 0; i < kElementsCount; ++i) {
+      state = state * 1664525 + 1013904223;
+      v.PushBack(static_cast<int>(state >> 1));
+    }
+    const int* data = v.Data();
+    std::sort(std::execution::par, v.begin(), v.end());
+    assert(v.Data() == data && v.Size() == size_t(kElementsCount));
+    assert(std::is_sorted(std::execution::par, v.begin(), v.end()));
+  }
+#endif  // WITH_PARALLEL_STL
+  std::cout << "[PASS] Iterators" << std::endl;
+#else
+  std::cout << "[SKIPPED] Iterators" << std::endl;
+#endif  // SKIP_ITERATORS
+
+#ifndef SKIP_BULK
+  {
+    using Counted = Vector<int, CountingAllocator<int>>;
+    std::vector<int> source(1000);
+    std::iota(source.begin(), source.end(), 0);
+
+    CountingAllocator<int>::allocations = 0;
+    Counted v;
+    v.Append(source.data(), source.data() + source.size());
+    assert(CountingAllocator<int>::allocations == 1);
+    assert(v.Size() == 1000 && v.Capacity() == 1000);
+    assert(std::equal(v.begin(), v.end(), source.begin()));
+
+    // Диапазон из элементов самого вектора.
+    v.Append(v.begin(), v.end());
+    assert(CountingAllocator<int>::allocations == 2);
+    assert(v.Size() == 2000 && v[1000] == 0 && v[1999] == 999);
+
+    v.Resize(10);
+    assert(v.Size() == 10 && v[9] == 9);
+    v.Resize(15);
+    assert(v.Size() == 15 && v[10] == 0 && v[14] == 0);
+    v.Resize(20, 7);
+    assert(v.Size() == 20 && v[15] == 7 && v[19] == 7);
+
+    v.Assign(source.begin() + 100, source.begin() + 105);
+    assert(v.Size() == 5 && v[0] == 100 && v[4] == 104);
+    v.Assign(3, v[1]);
+    assert(v.Size() == 3 && v[0] == 101 && v[2] == 101);
+
+    std::istringstream input("1 2 3 4");
+    v.Append(std::istream_iterator<int>(input), std::istream_iterator<int>());
+    assert(v.Size() == 7 && v[3] == 1 && v[6] == 4);
+  }
+  {
+    // Вставка в середину при наличии места (обе ветки сдвига),
+    // в начало при запасе перед элементами и с переездом.
+    auto make = [](int from, int to) {
+      std::list<std::string> result;
+      for (int i = from; i < to; ++i) {
+        result.push_back(std::to_string(i));
+      }
+      return result;
+    };
+    auto expect = [](const Vector<std::string>& v,
+                     const std::vector<int>& expected) {
+      assert(v.Size() == expected.size());
+      for (size_t i = 0; i < expected.size(); ++i) {
+        assert(v[i] == std::to_string(expected[i]));
+      }
+    };
+
+    Vector<std::string> v;
+    v.Reserve(100);
+    auto range = make(0, 10);
+    v.Append(range.begin(), range.end());
+
+    range = make(100, 102);
+    auto it = v.Insert(v.begin() + 7, range.begin(), range.end());
+    assert(it == v.begin() + 7 && *it == "100");
+    expect(v, {0, 1, 2, 3, 4, 5, 6, 100, 101, 7, 8, 9});
+
+    range = make(200, 205);
+    v.Insert(v.begin() + 10, range.begin(), range.end());
+    expect(v, {0, 1, 2, 3, 4, 5, 6, 100, 101, 7, 200, 201, 202, 203, 204,
+               8, 9});
+
+    range = make(300, 301);
+    v.Insert(v.end(), range.begin(), range.end());
+    assert(v[v.Size() - 1] == "300");
+
+    Vector<std::string> deque;
+    for (int i = 0; i < 4; ++i) {
+      deque.PushFront(std::to_string(3 - i));
+    }
+    size_t capacity = deque.Capacity();
+    range = make(-2, 0);
+    deque.Insert(deque.begin(), range.begin(), range.end());
+    expect(deque, {-2, -1, 0, 1, 2, 3});
+
+    range = make(10, 100);
+    deque.Insert(deque.begin() + 3, range.begin(), range.end());
+    assert(deque.Capacity() > capacity && deque.Size() == 96);
+    assert(deque[2] == "0" && deque[3] == "10" && deque[92] == "99");
+    assert(deque[93] == "1" && deque[95] == "3");
+
+    std::istringstream input("5 6");
+    Vector<int> ints;
+    ints.PushBack(1);
+    ints.PushBack(2);
+    ints.Insert(ints.begin() + 1, std::istream_iterator<int>(input),
+                std::istream_iterator<int>());
+    assert(ints.Size() == 4 && ints[1] == 5 && ints[2] == 6 && ints[3] == 2);
+
+    // Новые элементы инициализируются значением по умолчанию, даже если
+    // оно не состоит из нулевых байт.
+    struct Pair {
+      int first;
+      int second;
+    };
+    Vector<int Pair::*> members;
+    members.Resize(3);
+    assert(members[0] == nullptr && members[2] == nullptr);
+    members.Resize(5, &Pair::second);
+    assert(members[3] == &Pair::second && members[2] == nullptr);
+  }
+  std::cout << "[PASS] Bulk" << std::endl;
+#else
+  std::cout << "[SKIPPED] Bulk" << std::endl;
+#endif  // SKIP_BULK
+
+#ifndef SKIP_SMALL
+  {
+    CountingAllocator<int>::allocations = 0;
+    SmallVector<int, 8, CountingAllocator<int>> v;
+    for (int i = 0; i < 8; ++i) {
+      assert(v.EmplaceBack(i) == i);
+    }
+    assert(v.IsInline() && v.Size() == 8);
+    assert(CountingAllocator<int>::allocations == 0);
+    assert(v.Find(5) == 5 && v.Find(8) == v.npos);
+
+    v.PushBack(8);
+    assert(!v.IsInline() && CountingAllocator<int>::allocations == 1);
+    for (int i = 0; i < 9; ++i) {
+      assert(v[i] == i);
+    }
+    v.PopBack();
+    v[0] = 100;
+    assert(v.Size() == 8 && v[0] == 100);
+  }
+  {
+    using Small = SmallVector<std::string, 4>;
+    Small inline_v;
+    Small heap_v;
+    for (int i = 0; i < 3; ++i) {
+      inline_v.PushBack(std::to_string(i));
+    }
+    for (int i = 0; i < 10; ++i) {
+      heap_v.EmplaceBack(std::to_string(i));
+    }
+    assert(inline_v.IsInline() && !heap_v.IsInline());
+
+    // Копирование в обе стороны.
+    Small copy(heap_v);
+    assert(copy.Size() == 10 && copy[9] == "9" && heap_v[9] == "9");
+    copy = inline_v;
+    assert(copy.Size() == 3 && copy[2] == "2");
+    copy = heap_v;
+    assert(copy.Size() == 10 && copy[0] == "0");
+
+    // Перемещение кучи забирает память, встроенных элементов - переносит.
+    const std::string* heap_data = &heap_v[0];
+    Small moved_heap(std::move(heap_v));
+    assert(&moved_heap[0] == heap_data);
+    assert(heap_v.IsEmpty() && heap_v.IsInline());
+
+    Small moved_inline(std::move(inline_v));
+    assert(moved_inline.IsInline() && moved_inline.Size() == 3);
+    assert(moved_inline[1] == "1" && inline_v.IsEmpty());
+
+    moved_inline = std::move(moved_heap);
+    assert(!moved_inline.IsInline() && moved_inline.Size() == 10);
+    assert(&moved_inline[0] == heap_data);
+    moved_heap = std::move(copy);
+    assert(moved_heap.Size() == 10 && moved_heap[5] == "5");
+
+    // Аргумент может ссылаться на элемент при переезде в кучу.
+    Small self;
+    for (int i = 0; i < 4; ++i) {
+      self.PushBack(std::string(50, 'x'));
+    }
+    self.PushBack(self[0]);
+    assert(self.Size() == 5 && self[4] == std::string(50, 'x'));
+  }
+  {
+    // SmallVector из разных арен: перемещающее присваивание забирает
+    // аллокатор вместе с памятью, не выделяя её заново.
+    using StringAllocator = ArenaAllocator<std::string>;
+    using ArenaSmall = SmallVector<std::string, 2, StringAllocator>;
+    static_assert(std::is_nothrow_move_assignable_v<ArenaSmall>);
+    Arena first(1024);
+    Arena second(1024);
+    ArenaSmall heap_v{StringAllocator(&first)};
+    for (int i = 0; i < 10; ++i) {
+      heap_v.PushBack(std::to_string(i));
+    }
+    ArenaSmall target{StringAllocator(&second)};
+    target.PushBack("old");
+    size_t first_blocks = first.BlocksCount();
+    size_t second_blocks = second.BlocksCount();
+    const std::string* heap_data = &heap_v[0];
+    target = std::move(heap_v);
+    assert(&target[0] == heap_data && target.Size() == 10);
+    assert(target[9] == "9" && heap_v.IsEmpty());
+
+    ArenaSmall inline_v{StringAllocator(&first)};
+    inline_v.PushBack("0");
+    ArenaSmall inline_target{StringAllocator(&second)};
+    inline_target = std::move(inline_v);
+    assert(inline_target.IsInline() && inline_target[0] == "0");
+    for (int i = 1; i < 100; ++i) {
+      inline_target.PushBack(std::to_string(i));
+    }
+    assert(inline_target[99] == "99");
+    assert(first.BlocksCount() > first_blocks);
+    assert(second.BlocksCount() == second_blocks);
+  }
+  std::cout << "[PASS] SmallVector" << std::endl;
+#else
+  std::cout << "[SKIPPED] SmallVector" << std::endl;
+#endif  // SKIP_SMALL
+
+#ifdef RUN_BENCHMARKS
+  {
+    const int kFrontPushes = 1'000'000;
+    Vector<int> v;
+    double elapsed = MeasureMilliseconds([&v] {
+      for (int i = 0; i < kFrontPushes; ++i) {
+        v.PushFront(i);
+      }
+    });
+    assert(v.Size() == kFrontPushes && v[0] == kFrontPushes - 1);
+    std::cout << "[BENCH] PushFront x" << kFrontPushes << ": "
+              << elapsed << " ms" << std::endl;
+
+    // Прежняя реализация сдвигала весь массив на каждой вставке в начало,
+    // что по стоимости эквивалентно std::vector::insert(begin()).
+    // Квадратичный вариант измеряется на меньшем числе вставок.
+    const int kShiftingFrontPushes = kFrontPushes / 10;
+    std::vector<int> shifting;
+    double shifting_elapsed = MeasureMilliseconds([&shifting] {
+      for (int i = 0; i < kShiftingFrontPushes; ++i) {
+        shifting.insert(shifting.begin(), i);
+      }
+    });
+    std::cout << "[BENCH] Shifting PushFront x" << kShiftingFrontPushes
+              << ": " << shifting_elapsed << " ms" << std::endl;
+  }
+  {
+    // Много маленьких короткоживущих векторов: память арены
+    // освобождается разом в конце каждого "запроса".
+    const int kVectorsCount = 10'000'000;
+    const int kVectorsPerRequest = 1'000;
+    const int kElementsCount = 4;
+    long long checksum = 0;
+
+    double elapsed = MeasureMilliseconds([&checksum] {
+      for (int i = 0; i < kVectorsCount; ++i) {
+        Vector<int> v;
+        for (int j = 0; j < kElementsCount; ++j) {
+          v.PushBack(i + j);
+        }
+        checksum += v[kElementsCount - 1];
+      }
+    });
+    std::cout << "[BENCH] " << kVectorsCount << " small vectors, "
+              << "std::allocator: " << elapsed << " ms" << std::endl;
+
+    Arena arena;
+    double arena_elapsed = MeasureMilliseconds([&checksum, &arena] {
+      for (int i = 0; i < kVectorsCount; ++i) {
+        if (i % kVectorsPerRequest == 0) {
+          arena.Reset();
+        }
+        Vector<int, ArenaAllocator<int>> v{ArenaAllocator<int>(&arena)};
+        for (int j = 0; j < kElementsCount; ++j) {
+          v.PushBack(i + j);
+        }
+        checksum -= v[kElementsCount - 1];
+      }
+    });
+    assert(checksum == 0);
+    std::cout << "[BENCH] " << kVectorsCount << " small vectors, "
+              << "ArenaAllocator: " << arena_elapsed << " ms" << std::endl;
+  }
+  {
+    // Миллион коротких векторов по 6 элементов: число выделений памяти
+    // при построении и время обхода всех элементов. У Vector каждый
+    // обход элементов - переход по указателю в кучу; у SmallVector
+    // элементы лежат подряд с самими объектами. Аппаратные счётчики
+    // промахов кэша можно снять, запустив бенчмарк под 'perf stat'.
+    const int kVectorsCount = 1'000'000;
+    const int kElementsCount = 6;
+
+    CountingAllocator<int>::allocations = 0;
+    std::vector<Vector<int, CountingAllocator<int>>> vectors(kVectorsCount);
+    for (auto& v : vectors) {
+      for (int j = 0; j < kElementsCount; ++j) {
+        v.PushBack(j);
+      }
+    }
+    size_t vector_allocations = CountingAllocator<int>::allocations;
+
+    CountingAllocator<int>::allocations = 0;
+    std::vector<SmallVector<int, 8, CountingAllocator<int>>>
+        small_vectors(kVectorsCount);
+    for (auto& v : small_vectors) {
+      for (int j = 0; j < kElementsCount; ++j) {
+        v.PushBack(j);
+      }
+    }
+    size_t small_allocations = CountingAllocator<int>::allocations;
+
+    long long sum = 0;
+    double elapsed = MeasureMilliseconds([&] {
+      for (const auto& v : vectors) {
+        for (size_t j = 0; j < v.Size(); ++j) {
+          sum += v[j];
+        }
+      }
+    });
+    double small_elapsed = MeasureMilliseconds([&] {
+      for (const auto& v : small_vectors) {
+        for (size_t j = 0; j < v.Size(); ++j) {
+          sum -= v[j];
+        }
+      }
+    });
+    assert(sum == 0);
+    std::cout << "[BENCH] Vector<int>: " << vector_allocations
+              << " allocations, traversal " << elapsed << " ms" << std::endl;
+    std::cout << "[BENCH] SmallVector<int, 8>: " << small_allocations
+              << " allocations, traversal " << small_elapsed << " ms"
+              << std::endl;
+  }
+  {
+    // Поиск отсутствующего элемента (полный проход) по массивам от
+    // помещающихся в L1 до заведомо не помещающихся в кэш. Для каждого
+    // размера просматривается примерно одинаковый объём памяти.
+    const std::vector<size_t> kSizes(
+        {1 << 10, 1 << 14, 1 << 18, 1 << 22, 1 << 26});
+    const size_t kTotalElements = size_t(1) << 30;
+    for (size_t size : kSizes) {
+      Vector<int> v;
+      for (size_t i = 0; i < size; ++i) {
+        v.PushBack(static_cast<int>(i % 1000));
+      }
+      const size_t repeats = kTotalElements / size;
+      size_t found = 0;
+      double scalar_elapsed = MeasureMilliseconds([&] {
+        for (size_t i = 0; i < repeats; ++i) {
+          found += FindEqualScalar(&v[0], v.Size(), -1 - int(i % 2)) != v.npos;
+        }
+      });
+      double simd_elapsed = MeasureMilliseconds([&] {
+        for (size_t i = 0; i < repeats; ++i) {
+          found += v.Find(-1 - int(i % 2)) != v.npos;
+        }
+      });
+      assert(found == 0);
+      double gigabytes = double(repeats) * size * sizeof(int) / 1e9;
+      std::cout << "[BENCH] Find in Vector<int> of " << size
+                << " elements: scalar " << gigabytes / scalar_elapsed * 1e3
+                << " GB/s, SIMD " << gigabytes / simd_elapsed * 1e3
+                << " GB/s" << std::endl;
+    }
+  }
+  {
+    // Колебательная нагрузка: пачки вставок и удалений до почти пустого
+    // вектора и обратно, а также мелкие колебания вблизи степени двойки.
+    // Число переездов равно числу выделений памяти, объём скопированного -
+    // числу перемещений элементов.
+    auto replay = [](auto vector, const char* name) {
+      using Element = InstrumentedElement;
+      const int kBursts = 1'000;
+      const int kBurstSize = 10'000;
+      InstrumentedElement::ResetCounters();
+      CountingAllocator<Element>::allocations = 0;
+      double elapsed = MeasureMilliseconds([&vector] {
+        for (int burst = 0; burst < kBursts; ++burst) {
+          for (int i = 0; i < kBurstSize; ++i) {
+            vector.EmplaceBack(i);
+          }
+          while (vector.Size() > 1) {
+            vector.PopBack();
+          }
+        }
+        for (int i = 0; i < 1023; ++i) {
+          vector.EmplaceBack(i);
+        }
+        for (int i = 0; i < 100'000; ++i) {
+          vector.EmplaceBack(i);
+          vector.EmplaceBack(i);
+          vector.PopBack();
+          vector.PopBack();
+        }
+      });
+      std::cout << "[BENCH] Oscillating trace, " << name << ": "
+                << CountingAllocator<Element>::allocations << " relocations, "
+                << InstrumentedElement::move_constructions * sizeof(Element)
+                << " bytes copied, " << elapsed << " ms" << std::endl;
+    };
+    using Alloc = CountingAllocator<InstrumentedElement>;
+    replay(Vector<InstrumentedElement, Alloc, DoublingGrowth>(), "2x");
+    replay(Vector<InstrumentedElement, Alloc, HalfGrowth>(), "1.5x");
+    replay(Vector<InstrumentedElement, Alloc, FixedChunkGrowth<4096>>(),
+           "+4096");
+    replay(Vector<InstrumentedElement, Alloc, NoAutoShrink<DoublingGrowth>>(),
+           "2x, no auto-shrink");
+  }
+  {
+    const size_t kElementsCount = 100'000'000;
+    std::vector<int> source(kElementsCount);
+    std::iota(source.begin(), source.end(), 0);
+
+    double push_elapsed;
+    {
+      Vector<int> v;
+      push_elapsed = MeasureMilliseconds([&] {
+        for (int value : source) {
+          v.PushBack(value);
+        }
+      });
+      assert(v.Size() == kElementsCount);
+    }
+    double append_elapsed;
+    {
+      Vector<int> v;
+      append_elapsed = MeasureMilliseconds([&] {
+        v.Append(source.data(), source.data() + source.size());
+      });
+      assert(v.Size() == kElementsCount);
+      assert(v[kElementsCount - 1] == 99'999'999);
+    }
+    std::cout << "[BENCH] " << kElementsCount << " ints: PushBack loop "
+              << push_elapsed << " ms, Append " << append_elapsed << " ms"
+              << std::endl;
+  }
+#endif  // RUN_BENCHMARKS
+
   std::cout << "Finished!" << std::endl;
 
   return 0;
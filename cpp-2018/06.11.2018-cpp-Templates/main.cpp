@@ -83,14 +83,15 @@ ostream& operator<<(ostream& out, const vector<T>& vi) {
 
 template<typename RandomIt>
 void MergeSort(RandomIt range_begin, RandomIt range_end) {
-  if (range_end == range_begin + 1) return;
+  if (range_end - range_begin < 2) return;
 
   RandomIt range_middle = range_begin + (range_end - range_begin) / 2;
   MergeSort(range_begin, range_middle);
   MergeSort(range_middle, range_end);
 
-  vector<typename RandomIt::value_type> elements_left(range_begin, range_middle);
-  vector<typename RandomIt::value_type> elements_right(range_middle, range_end);
+  using ValueType = typename iterator_traits<RandomIt>::value_type;
+  vector<ValueType> elements_left(range_begin, range_middle);
+  vector<ValueType> elements_right(range_middle, range_end);
 
   merge(begin(elements_left), end(elements_left),
         begin(elements_right), end(elements_right),
@@ -131,6 +132,12 @@ int main() {
     }
     cout << "\n";
   }
+  {
+    // Итераторами могут быть и обычные указатели.
+    int a[] = {3, 1, 2};
+    MergeSort(begin(a), end(a));
+    cout << a[0] << " " << a[1] << " " << a[2] << "\n";
+  }
 
   return 0;
 }
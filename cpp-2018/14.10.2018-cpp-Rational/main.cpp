@@ -1,188 +1,1246 @@
 #include <iostream>
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <ratio>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+// Arbitrary-precision signed integer. The magnitude is stored in base 2^32,
+// least significant limb first and without leading zero limbs (zero has no
+// limbs). Division truncates toward zero, like for built-in integers.
+class BigInt {
+ public:
+  BigInt(int64_t value = 0);
+
+  bool IsZero() const {
+    return limbs_.empty();
+  }
+
+  bool IsNegative() const {
+    return negative_;
+  }
+
+  std::string ToString() const;
+
+  // Returns m such that the value equals m * 2^(*exponent) and
+  // 0.5 <= |m| < 1 (m = 0 for zero). Works far beyond the range of double.
+  double Frexp(int64_t *exponent) const;
+
+  BigInt operator-() const;
+
+  BigInt &operator+=(const BigInt &other);
+  BigInt &operator-=(const BigInt &other);
+  BigInt &operator*=(const BigInt &other);
+  BigInt &operator/=(const BigInt &other);
+  BigInt &operator%=(const BigInt &other);
+
+  friend BigInt operator+(BigInt lhs, const BigInt &rhs) {
+    return lhs += rhs;
+  }
+
+  friend BigInt operator-(BigInt lhs, const BigInt &rhs) {
+    return lhs -= rhs;
+  }
+
+  friend BigInt operator*(BigInt lhs, const BigInt &rhs) {
+    return lhs *= rhs;
+  }
+
+  friend BigInt operator/(BigInt lhs, const BigInt &rhs) {
+    return lhs /= rhs;
+  }
+
+  friend BigInt operator%(BigInt lhs, const BigInt &rhs) {
+    return lhs %= rhs;
+  }
+
+  friend bool operator==(const BigInt &lhs, const BigInt &rhs) {
+    return lhs.negative_ == rhs.negative_ && lhs.limbs_ == rhs.limbs_;
+  }
+
+  friend bool operator!=(const BigInt &lhs, const BigInt &rhs) {
+    return !(lhs == rhs);
+  }
+
+  friend bool operator<(const BigInt &lhs, const BigInt &rhs) {
+    if (lhs.negative_ != rhs.negative_) {
+      return lhs.negative_;
+    }
+    int comparison = CompareMagnitudes(lhs.limbs_, rhs.limbs_);
+    return lhs.negative_ ? comparison > 0 : comparison < 0;
+  }
+
+  friend bool operator<=(const BigInt &lhs, const BigInt &rhs) {
+    return !(rhs < lhs);
+  }
+
+  friend bool operator>(const BigInt &lhs, const BigInt &rhs) {
+    return rhs < lhs;
+  }
+
+  friend bool operator>=(const BigInt &lhs, const BigInt &rhs) {
+    return !(lhs < rhs);
+  }
+
+  friend std::ostream &operator<<(std::ostream &out, const BigInt &value) {
+    return out << value.ToString();
+  }
+
+  // Greatest common divisor of |a| and |b| by the binary (Stein) algorithm.
+  friend BigInt Gcd(const BigInt &a, const BigInt &b);
+
+ private:
+  using Limbs = std::vector<uint32_t>;
+
+  // Below this many limbs schoolbook multiplication is faster than
+  // Karatsuba's.
+  static constexpr size_t kKaratsubaThreshold = 32;
+
+  bool negative_;
+  Limbs limbs_;
+
+  // Adds 'other' (negated if 'negate') to *this.
+  BigInt &AddSigned(const BigInt &other, bool negate);
+
+  // Replaces *this with the quotient (or the remainder if 'remainder').
+  BigInt &Divide(const BigInt &other, bool remainder);
+
+  static void Trim(Limbs *a);
+  static int CompareMagnitudes(const Limbs &a, const Limbs &b);
+
+  // *a += b * 2^(32 * shift).
+  static void AddMagnitudes(Limbs *a, const Limbs &b, size_t shift = 0);
+
+  // *a -= b; requires *a >= b.
+  static void SubtractMagnitudes(Limbs *a, const Limbs &b);
+
+  static Limbs Multiply(const uint32_t *a, size_t a_size,
+                        const uint32_t *b, size_t b_size);
+  static Limbs MultiplySchoolbook(const uint32_t *a, size_t a_size,
+                                  const uint32_t *b, size_t b_size);
+
+  // *a /= divisor; returns the remainder.
+  static uint32_t DivideBySmall(Limbs *a, uint32_t divisor);
+
+  // Long division (Knuth, TAOCP 4.3.1, algorithm D).
+  static void DivideMagnitudes(const Limbs &a, const Limbs &b,
+                               Limbs *quotient, Limbs *remainder);
+
+  static void ShiftLeft(Limbs *a, size_t bits);
+  static void ShiftRight(Limbs *a, size_t bits);
+  static size_t CountTrailingZeros(const Limbs &a);
+};
+
+BigInt::BigInt(int64_t value) : negative_(value < 0) {
+  uint64_t magnitude = negative_ ? 0 - static_cast<uint64_t>(value)
+                                 : static_cast<uint64_t>(value);
+  while (magnitude != 0) {
+    limbs_.push_back(static_cast<uint32_t>(magnitude));
+    magnitude >>= 32;
+  }
+}
+
+std::string BigInt::ToString() const {
+  if (IsZero()) {
+    return "0";
+  }
+  const uint32_t kChunk = 1000000000;
+  std::vector<uint32_t> chunks;
+  Limbs rest = limbs_;
+  while (!rest.empty()) {
+    chunks.push_back(DivideBySmall(&rest, kChunk));
+  }
+  std::string result = negative_ ? "-" : "";
+  result += std::to_string(chunks.back());
+  for (size_t i = chunks.size() - 1; i-- > 0;) {
+    std::string digits = std::to_string(chunks[i]);
+    result.append(9 - digits.size(), '0');
+    result += digits;
+  }
+  return result;
+}
+
+double BigInt::Frexp(int64_t *exponent) const {
+  double top = 0;
+  size_t taken = std::min<size_t>(limbs_.size(), 3);
+  for (size_t i = limbs_.size(); i-- > limbs_.size() - taken;) {
+    top = top * 4294967296.0 + limbs_[i];
+  }
+  int top_exponent = 0;
+  double mantissa = std::frexp(top, &top_exponent);
+  *exponent = top_exponent + 32 * int64_t(limbs_.size() - taken);
+  return negative_ ? -mantissa : mantissa;
+}
+
+BigInt BigInt::operator-() const {
+  BigInt result = *this;
+  result.negative_ = !IsZero() && !negative_;
+  return result;
+}
+
+BigInt &BigInt::operator+=(const BigInt &other) {
+  return AddSigned(other, false);
+}
+
+BigInt &BigInt::operator-=(const BigInt &other) {
+  return AddSigned(other, true);
+}
+
+BigInt &BigInt::operator*=(const BigInt &other) {
+  limbs_ = Multiply(limbs_.data(), limbs_.size(),
+                    other.limbs_.data(), other.limbs_.size());
+  negative_ = !IsZero() && negative_ != other.negative_;
+  return *this;
+}
+
+BigInt &BigInt::operator/=(const BigInt &other) {
+  return Divide(other, false);
+}
+
+BigInt &BigInt::operator%=(const BigInt &other) {
+  return Divide(other, true);
+}
+
+BigInt &BigInt::AddSigned(const BigInt &other, bool negate) {
+  if (&other == this) {
+    return AddSigned(BigInt(other), negate);
+  }
+  bool other_negative = other.negative_ != negate;
+  if (negative_ == other_negative) {
+    AddMagnitudes(&limbs_, other.limbs_);
+  } else if (CompareMagnitudes(limbs_, other.limbs_) >= 0) {
+    SubtractMagnitudes(&limbs_, other.limbs_);
+  } else {
+    Limbs difference = other.limbs_;
+    SubtractMagnitudes(&difference, limbs_);
+    limbs_ = std::move(difference);
+    negative_ = other_negative;
+  }
+  if (IsZero()) {
+    negative_ = false;
+  }
+  return *this;
+}
+
+BigInt &BigInt::Divide(const BigInt &other, bool remainder) {
+  if (other.IsZero()) {
+    throw std::runtime_error("Diving by zero");
+  }
+  Limbs quotient;
+  Limbs rest;
+  DivideMagnitudes(limbs_, other.limbs_, &quotient, &rest);
+  if (remainder) {
+    limbs_ = std::move(rest);
+  } else {
+    limbs_ = std::move(quotient);
+    negative_ = negative_ != other.negative_;
+  }
+  if (IsZero()) {
+    negative_ = false;
+  }
+  return *this;
+}
+
+BigInt Gcd(const BigInt &a, const BigInt &b) {
+  using Limbs = BigInt::Limbs;
+  BigInt result;
+  if (a.IsZero() || b.IsZero()) {
+    result.limbs_ = a.IsZero() ? b.limbs_ : a.limbs_;
+    return result;
+  }
+  Limbs x = a.limbs_;
+  Limbs y = b.limbs_;
+  size_t x_zeros = BigInt::CountTrailingZeros(x);
+  size_t y_zeros = BigInt::CountTrailingZeros(y);
+  size_t common_zeros = std::min(x_zeros, y_zeros);
+  BigInt::ShiftRight(&x, x_zeros);
+  BigInt::ShiftRight(&y, y_zeros);
+  // Both are odd and so is their GCD, hence factors of two can be
+  // dropped from either of them at any time.
+  while (!x.empty() && !y.empty()) {
+    if (x.size() > y.size() + 1 || y.size() > x.size() + 1) {
+      // Subtractions would shrink the longer number a few bits at a time;
+      // one Euclidean step shrinks it to the length of the shorter one.
+      Limbs *longer = x.size() > y.size() ? &x : &y;
+      const Limbs &shorter = x.size() > y.size() ? y : x;
+      Limbs quotient;
+      Limbs rest;
+      BigInt::DivideMagnitudes(*longer, shorter, &quotient, &rest);
+      *longer = std::move(rest);
+    } else {
+      if (BigInt::CompareMagnitudes(x, y) > 0) {
+        std::swap(x, y);
+      }
+      BigInt::SubtractMagnitudes(&y, x);
+    }
+    if (!x.empty()) {
+      BigInt::ShiftRight(&x, BigInt::CountTrailingZeros(x));
+    }
+    if (!y.empty()) {
+      BigInt::ShiftRight(&y, BigInt::CountTrailingZeros(y));
+    }
+  }
+  result.limbs_ = x.empty() ? std::move(y) : std::move(x);
+  BigInt::ShiftLeft(&result.limbs_, common_zeros);
+  return result;
+}
+
+void BigInt::Trim(Limbs *a) {
+  while (!a->empty() && a->back() == 0) {
+    a->pop_back();
+  }
+}
+
+int BigInt::CompareMagnitudes(const Limbs &a, const Limbs &b) {
+  if (a.size() != b.size()) {
+    return a.size() < b.size() ? -1 : 1;
+  }
+  for (size_t i = a.size(); i-- > 0;) {
+    if (a[i] != b[i]) {
+      return a[i] < b[i] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+void BigInt::AddMagnitudes(Limbs *a, const Limbs &b, size_t shift) {
+  if (a->size() < b.size() + shift) {
+    a->resize(b.size() + shift, 0);
+  }
+  uint64_t carry = 0;
+  size_t i = 0;
+  for (; i < b.size(); ++i) {
+    uint64_t sum = uint64_t((*a)[i + shift]) + b[i] + carry;
+    (*a)[i + shift] = static_cast<uint32_t>(sum);
+    carry = sum >> 32;
+  }
+  for (i += shift; carry != 0 && i < a->size(); ++i) {
+    uint64_t sum = uint64_t((*a)[i]) + carry;
+    (*a)[i] = static_cast<uint32_t>(sum);
+    carry = sum >> 32;
+  }
+  if (carry != 0) {
+    a->push_back(static_cast<uint32_t>(carry));
+  }
+}
+
+void BigInt::SubtractMagnitudes(Limbs *a, const Limbs &b) {
+  int64_t borrow = 0;
+  size_t i = 0;
+  for (; i < b.size(); ++i) {
+    int64_t difference = int64_t((*a)[i]) - b[i] - borrow;
+    borrow = difference < 0;
+    (*a)[i] = static_cast<uint32_t>(difference);
+  }
+  for (; borrow != 0; ++i) {
+    assert(i < a->size());
+    borrow = (*a)[i] == 0;
+    --(*a)[i];
+  }
+  Trim(a);
+}
+
+BigInt::Limbs BigInt::Multiply(const uint32_t *a, size_t a_size,
+                               const uint32_t *b, size_t b_size) {
+  if (a_size < b_size) {
+    std::swap(a, b);
+    std::swap(a_size, b_size);
+  }
+  if (b_size < kKaratsubaThreshold) {
+    return MultiplySchoolbook(a, a_size, b, b_size);
+  }
+  if (2 * b_size <= a_size) {
+    // Unbalanced operands: multiply 'b' by chunks of 'a' of its length.
+    Limbs result(a_size + b_size, 0);
+    for (size_t offset = 0; offset < a_size; offset += b_size) {
+      AddMagnitudes(&result,
+                    Multiply(a + offset, std::min(b_size, a_size - offset),
+                             b, b_size),
+                    offset);
+    }
+    Trim(&result);
+    return result;
+  }
+  // Karatsuba: with a = a1 * B + a0 and b = b1 * B + b0,
+  // a * b = z2 * B^2 + ((a0 + a1) * (b0 + b1) - z2 - z0) * B + z0,
+  // where z0 = a0 * b0 and z2 = a1 * b1: three products instead of four.
+  size_t half = a_size / 2;
+  Limbs z0 = Multiply(a, half, b, half);
+  Limbs z2 = Multiply(a + half, a_size - half, b + half, b_size - half);
+  Limbs a_sum(a, a + half);
+  Limbs b_sum(b, b + half);
+  AddMagnitudes(&a_sum, Limbs(a + half, a + a_size));
+  AddMagnitudes(&b_sum, Limbs(b + half, b + b_size));
+  Trim(&a_sum);
+  Trim(&b_sum);
+  Limbs z1 = Multiply(a_sum.data(), a_sum.size(), b_sum.data(), b_sum.size());
+  SubtractMagnitudes(&z1, z0);
+  SubtractMagnitudes(&z1, z2);
+  Limbs result(a_size + b_size, 0);
+  AddMagnitudes(&result, z0);
+  AddMagnitudes(&result, z1, half);
+  AddMagnitudes(&result, z2, 2 * half);
+  Trim(&result);
+  return result;
+}
+
+BigInt::Limbs BigInt::MultiplySchoolbook(const uint32_t *a, size_t a_size,
+                                         const uint32_t *b, size_t b_size) {
+  Limbs result(a_size + b_size, 0);
+  for (size_t i = 0; i < a_size; ++i) {
+    uint64_t carry = 0;
+    for (size_t j = 0; j < b_size; ++j) {
+      uint64_t product = uint64_t(a[i]) * b[j] + result[i + j] + carry;
+      result[i + j] = static_cast<uint32_t>(product);
+      carry = product >> 32;
+    }
+    result[i + b_size] = static_cast<uint32_t>(carry);
+  }
+  Trim(&result);
+  return result;
+}
+
+uint32_t BigInt::DivideBySmall(Limbs *a, uint32_t divisor) {
+  uint64_t remainder = 0;
+  for (size_t i = a->size(); i-- > 0;) {
+    uint64_t current = (remainder << 32) | (*a)[i];
+    (*a)[i] = static_cast<uint32_t>(current / divisor);
+    remainder = current % divisor;
+  }
+  Trim(a);
+  return static_cast<uint32_t>(remainder);
+}
+
+void BigInt::DivideMagnitudes(const Limbs &a, const Limbs &b,
+                              Limbs *quotient, Limbs *remainder) {
+  if (CompareMagnitudes(a, b) < 0) {
+    quotient->clear();
+    *remainder = a;
+    return;
+  }
+  if (b.size() == 1) {
+    *quotient = a;
+    uint32_t rest = DivideBySmall(quotient, b[0]);
+    remainder->assign(rest == 0 ? 0 : 1, rest);
+    return;
+  }
+  // Normalize so that the top bit of the divisor is set: then each
+  // estimated quotient digit is at most two too large.
+  size_t shift = __builtin_clz(b.back());
+  Limbs v = b;
+  Limbs u = a;
+  ShiftLeft(&v, shift);
+  ShiftLeft(&u, shift);
+  u.resize(a.size() + 1, 0);
+  size_t n = v.size();
+  size_t m = u.size() - n;
+  quotient->assign(m, 0);
+  const uint64_t kBase = uint64_t(1) << 32;
+  for (size_t j = m; j-- > 0;) {
+    uint64_t top = (uint64_t(u[j + n]) << 32) | u[j + n - 1];
+    uint64_t digit = top / v[n - 1];
+    uint64_t rest = top % v[n - 1];
+    while (digit >= kBase
+           || digit * v[n - 2] > ((rest << 32) | u[j + n - 2])) {
+      --digit;
+      rest += v[n - 1];
+      if (rest >= kBase) {
+        break;
+      }
+    }
+    int64_t borrow = 0;
+    uint64_t carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+      uint64_t product = digit * v[i] + carry;
+      carry = product >> 32;
+      int64_t difference = int64_t(u[i + j]) - borrow
+          - int64_t(product & 0xFFFFFFFF);
+      u[i + j] = static_cast<uint32_t>(difference);
+      borrow = difference < 0;
+    }
+    int64_t difference = int64_t(u[j + n]) - borrow - int64_t(carry);
+    u[j + n] = static_cast<uint32_t>(difference);
+    if (difference < 0) {
+      // The estimate was one too large: add the divisor back.
+      --digit;
+      carry = 0;
+      for (size_t i = 0; i < n; ++i) {
+        uint64_t sum = uint64_t(u[i + j]) + v[i] + carry;
+        u[i + j] = static_cast<uint32_t>(sum);
+        carry = sum >> 32;
+      }
+      u[j + n] += static_cast<uint32_t>(carry);
+    }
+    (*quotient)[j] = static_cast<uint32_t>(digit);
+  }
+  Trim(quotient);
+  u.resize(n);
+  ShiftRight(&u, shift);
+  Trim(&u);
+  *remainder = std::move(u);
+}
+
+void BigInt::ShiftLeft(Limbs *a, size_t bits) {
+  if (a->empty()) {
+    return;
+  }
+  size_t limbs = bits / 32;
+  bits %= 32;
+  if (bits != 0) {
+    uint32_t carry = 0;
+    for (uint32_t &limb : *a) {
+      uint32_t next_carry = limb >> (32 - bits);
+      limb = (limb << bits) | carry;
+      carry = next_carry;
+    }
+    if (carry != 0) {
+      a->push_back(carry);
+    }
+  }
+  a->insert(a->begin(), limbs, 0);
+}
+
+void BigInt::ShiftRight(Limbs *a, size_t bits) {
+  size_t limbs = std::min(bits / 32, a->size());
+  a->erase(a->begin(), a->begin() + limbs);
+  bits %= 32;
+  if (bits != 0) {
+    for (size_t i = 0; i < a->size(); ++i) {
+      uint32_t high = i + 1 < a->size() ? (*a)[i + 1] : 0;
+      (*a)[i] = ((*a)[i] >> bits) | (high << (32 - bits));
+    }
+    Trim(a);
+  }
+}
+
+size_t BigInt::CountTrailingZeros(const Limbs &a) {
+  size_t i = 0;
+  while (a[i] == 0) {
+    ++i;
+  }
+  return 32 * i + __builtin_ctz(a[i]);
+}
+
+// Modes of Rational, can be combined.
+// With kRationalChecked operations throw std::overflow_error when a result
+// does not fit into the integer type instead of silently wrapping around
+// (BigInt never overflows).
+// With kRationalLazy results are not reduced while they fit into the
+// integer type; they are reduced on overflow and compared by
+// cross-multiplication, and the observers see reduced values, so all
+// results are the same as without it. Only for built-in integer types.
+enum RationalMode : unsigned {
+  kRationalDefault = 0,
+  kRationalChecked = 1,
+  kRationalLazy = 2,
+};
+
+// Integer type wide enough for a product of two values of type Int.
+template<typename Int>
+struct RationalWide;
+
+template<>
+struct RationalWide<int> {
+  using Type = int64_t;
+};
+
+template<>
+struct RationalWide<int64_t> {
+  using Type = __int128;
+};
+
+template<>
+struct RationalWide<BigInt> {
+  using Type = BigInt;
+};
+
+template<typename Int>
+constexpr Int Abs(const Int &x) {
+  return x < 0 ? -x : x;
+}
+
+template<typename Int>
+constexpr int CountTrailingZeros(Int x) {
+  if constexpr (sizeof(Int) <= sizeof(unsigned)) {
+    return __builtin_ctz(static_cast<unsigned>(x));
+  } else if constexpr (sizeof(Int) <= sizeof(uint64_t)) {
+    return __builtin_ctzll(static_cast<uint64_t>(x));
+  } else {
+    uint64_t low = static_cast<uint64_t>(x);
+    return low != 0 ? __builtin_ctzll(low)
+                    : 64 + __builtin_ctzll(static_cast<uint64_t>(x >> 64));
+  }
+}
+
+// Binary (Stein) GCD of non-negative a and b: shifts and subtractions
+// instead of divisions. A negative operand, which a wrapped-around
+// denominator can produce in the default mode, falls back to Euclid's
+// algorithm, whose result it always had.
+template<typename Int>
+constexpr Int Gcd(Int a, Int b) {
+  if (a == 0 || b == 0) {
+    return a | b;
+  }
+  if (a < 0 || b < 0) {
+    while (b != 0) {
+      Int remainder = a % b;
+      a = b;
+      b = remainder;
+    }
+    return a;
+  }
+  if constexpr (sizeof(Int) > sizeof(uint64_t)) {
+    // Wide intermediates are usually small: stay in 64-bit registers.
+    if (((a | b) >> 64) == 0) {
+      return Gcd(static_cast<uint64_t>(a), static_cast<uint64_t>(b));
+    }
+  }
+  int shift = CountTrailingZeros(a | b);
+  a >>= CountTrailingZeros(a);
+  do {
+    b >>= CountTrailingZeros(b);
+    if (a > b) {
+      Int t = a;
+      a = b;
+      b = t;
+    }
+    b -= a;
+  } while (b != 0);
+  return a << shift;
+}
+
+template<typename Int>
+constexpr double RatioToDouble(const Int &a, const Int &b) {
+  return (double) a / b;
+}
+
+double RatioToDouble(const BigInt &a, const BigInt &b) {
+  int64_t a_exponent;
+  int64_t b_exponent;
+  double a_mantissa = a.Frexp(&a_exponent);
+  double b_mantissa = b.Frexp(&b_exponent);
+  return std::ldexp(a_mantissa / b_mantissa, a_exponent - b_exponent);
+}
+
+// Fraction of integers of type Int: int, int64_t or BigInt.
+// Intermediate values are computed in the twice wider type and fractions
+// are reduced by cross-GCDs before multiplying, so a result is exact
+// whenever its reduced form fits into Int.
+// For built-in integer types everything but printing is constexpr, so
+// constants and tables of fractions can be computed at compile time.
+template<typename Int = int, unsigned kMode = kRationalDefault>
 class Rational {
+  static_assert(!(kMode & kRationalLazy) || !std::is_same_v<Int, BigInt>,
+                "BigInt never overflows, so lazy results would never be "
+                "reduced");
+
  public:
-  Rational() : numerator_(0), denominator_(1) {}
+  constexpr Rational() : numerator_(0), denominator_(1) {}
 
-  explicit Rational(int x) : numerator_(x), denominator_(1) {}
+  constexpr explicit Rational(Int x)
+      : numerator_(std::move(x)), denominator_(1) {}
 
-  Rational(int x, int y) : numerator_(x), denominator_(y) {
-    Normalize();
+  constexpr Rational(const Int &x, const Int &y) : Rational() {
+    Assign(x, y);
   }
 
-  double GetValue() const {
-    return (double) numerator_ / denominator_;
+  constexpr double GetValue() const {
+    Rational reduced = Reduced();
+    return RatioToDouble(reduced.numerator_, reduced.denominator_);
   }
 
   void PrintFraction() const {
-    std::cout << "Value is " << numerator_ << '/' << denominator_ << "\n";
+    Rational reduced = Reduced();
+    std::cout << "Value is " << reduced.numerator_ << '/'
+              << reduced.denominator_ << "\n";
   }
 
-  Rational operator+() const;
-  Rational operator-() const;
+  constexpr Int GetNumerator() const {
+    return Reduced().numerator_;
+  }
+
+  constexpr Int GetDenominator() const {
+    return Reduced().denominator_;
+  }
 
-  Rational operator+(const Rational &other) const;
-  Rational operator+(int num) const;
-  Rational &operator+=(const Rational &other);
-  friend Rational operator+(int num, const Rational &other);
+  constexpr Rational operator+() const;
+  constexpr Rational operator-() const;
+
+  constexpr Rational operator+(const Rational &other) const;
+  constexpr Rational operator+(const Int &num) const;
+  constexpr Rational &operator+=(const Rational &other);
+  friend constexpr Rational operator+(const Int &num, const Rational &other) {
+    return other + num;
+  }
 
-  Rational operator-(const Rational &other) const;
-  Rational operator-(int num) const;
-  Rational &operator-=(const Rational &other);
-  friend Rational operator-(int num, const Rational &other);
+  constexpr Rational operator-(const Rational &other) const;
+  constexpr Rational operator-(const Int &num) const;
+  constexpr Rational &operator-=(const Rational &other);
+  friend constexpr Rational operator-(const Int &num, const Rational &other) {
+    return -(other - num);
+  }
 
-  Rational operator*(const Rational &other) const;
-  Rational operator*(int num) const;
-  Rational &operator*=(const Rational &other);
-  friend Rational operator*(int num, const Rational &other);
+  constexpr Rational operator*(const Rational &other) const;
+  constexpr Rational operator*(const Int &num) const;
+  constexpr Rational &operator*=(const Rational &other);
+  friend constexpr Rational operator*(const Int &num, const Rational &other) {
+    return other * num;
+  }
 
-  Rational operator/(const Rational &other) const;
-  Rational operator/(int num) const;
-  Rational &operator/=(const Rational &other);
-  friend Rational operator/(int num, const Rational &other);
+  constexpr Rational operator/(const Rational &other) const;
+  constexpr Rational operator/(const Int &num) const;
+  constexpr Rational &operator/=(const Rational &other);
+  friend constexpr Rational operator/(const Int &num, const Rational &other) {
+    return Rational(num) / other;
+  }
 
-  bool operator==(const Rational &other) const;
-  bool operator!=(const Rational &other) const;
-  bool operator<(const Rational &other) const;
-  bool operator<=(const Rational &other) const;
-  bool operator>(const Rational &other) const;
-  bool operator>=(const Rational &other) const;
+  constexpr bool operator==(const Rational &other) const;
+  constexpr bool operator!=(const Rational &other) const;
+  constexpr bool operator<(const Rational &other) const;
+  constexpr bool operator<=(const Rational &other) const;
+  constexpr bool operator>(const Rational &other) const;
+  constexpr bool operator>=(const Rational &other) const;
 
  private:
-  int numerator_;
-  int denominator_;
+  using Wide = typename RationalWide<Int>::Type;
+
+  Int numerator_;
+  Int denominator_;
+
+  static constexpr Int Narrow(Wide value) {
+    if constexpr (std::is_same_v<Int, Wide>) {
+      return value;
+    } else {
+      if (kMode & kRationalChecked) {
+        if (value < std::numeric_limits<Int>::min()
+            || value > std::numeric_limits<Int>::max()) {
+          throw std::overflow_error("Rational overflow");
+        }
+      }
+      return static_cast<Int>(value);
+    }
+  }
 
-  int Gcd(int a, int b) const {
-    return b ? Gcd(b, a % b) : a;
+  static constexpr bool Fits(const Wide &value) {
+    if constexpr (std::is_same_v<Int, Wide>) {
+      return true;
+    } else {
+      return value >= std::numeric_limits<Int>::min()
+          && value <= std::numeric_limits<Int>::max();
+    }
   }
 
-  void Normalize() {
-    if (denominator_ == 0) {
+  // Stores x / y with a positive denominator, reduced to lowest terms
+  // unless in lazy mode.
+  constexpr void Assign(Wide x, Wide y) {
+    if (y == 0) {
       throw std::runtime_error("Diving by zero");
     }
-    int gcd = Gcd(abs(numerator_), abs(denominator_));
-    numerator_ /= gcd;
-    denominator_ /= gcd;
-    if (denominator_ < 0) {
-      numerator_ *= -1;
-      denominator_ *= -1;
+    if (y < 0) {
+      x = -x;
+      y = -y;
+    }
+    if (kMode & kRationalLazy) {
+      AssignResult(std::move(x), std::move(y));
+    } else {
+      Reduce(std::move(x), std::move(y));
+    }
+  }
+
+  // Stores x / y, y > 0, reduced to lowest terms.
+  constexpr void Reduce(Wide x, Wide y) {
+    Wide gcd = Gcd(Abs(x), y);
+    AssignReduced(x / gcd, y / gcd);
+  }
+
+  // Stores x / y, y > 0, which is reduced unless in lazy mode.
+  constexpr void AssignResult(Wide x, Wide y) {
+    if ((kMode & kRationalLazy) && (!Fits(x) || !Fits(y))) {
+      Reduce(std::move(x), std::move(y));
+    } else {
+      AssignReduced(std::move(x), std::move(y));
+    }
+  }
+
+  constexpr void AssignReduced(Wide x, Wide y) {
+    numerator_ = Narrow(std::move(x));
+    denominator_ = Narrow(std::move(y));
+  }
+
+  constexpr Rational Reduced() const {
+    Rational result = *this;
+    if (kMode & kRationalLazy) {
+      result.Reduce(numerator_, denominator_);
     }
+    return result;
   }
+
+  // a / b + c / d and a / b * c / d for fractions with b, d > 0, reduced
+  // unless in lazy mode.
+  static constexpr Rational Add(const Wide &a, const Wide &b,
+                                const Wide &c, const Wide &d);
+  static constexpr Rational Multiply(const Wide &a, const Wide &b,
+                                     const Wide &c, const Wide &d);
 };
 
-Rational Rational::operator-() const {
-  return {-numerator_, denominator_};
+template<typename Int, unsigned kMode>
+constexpr Rational<Int, kMode>
+Rational<Int, kMode>::Add(const Wide &a, const Wide &b,
+                          const Wide &c, const Wide &d) {
+  // Knuth, TAOCP 4.5.1: with g = gcd(b, d) the sum is
+  // (a * (d / g) + c * (b / g)) / (b / g * d), and only g can share
+  // factors with the new numerator.
+  Rational result;
+  if (kMode & kRationalLazy) {
+    result.AssignResult(a * d + c * b, b * d);
+    return result;
+  }
+  Wide gcd = Gcd(b, d);
+  if (gcd == 1) {
+    result.AssignReduced(a * d + c * b, b * d);
+    return result;
+  }
+  Wide numerator = a * (d / gcd) + c * (b / gcd);
+  Wide common = Gcd(Abs(numerator), gcd);
+  result.AssignReduced(numerator / common, b / gcd * (d / common));
+  return result;
+}
+
+template<typename Int, unsigned kMode>
+constexpr Rational<Int, kMode>
+Rational<Int, kMode>::Multiply(const Wide &a, const Wide &b,
+                               const Wide &c, const Wide &d) {
+  Rational result;
+  if (kMode & kRationalLazy) {
+    result.AssignResult(a * c, b * d);
+    return result;
+  }
+  Wide gcd_ad = Gcd(Abs(a), d);
+  Wide gcd_cb = Gcd(Abs(c), b);
+  result.AssignReduced((a / gcd_ad) * (c / gcd_cb),
+                       (b / gcd_cb) * (d / gcd_ad));
+  return result;
 }
 
-Rational Rational::operator+() const {
+template<typename Int, unsigned kMode>
+constexpr Rational<Int, kMode> Rational<Int, kMode>::operator-() const {
+  Rational result;
+  result.AssignResult(-Wide(numerator_), denominator_);
+  return result;
+}
+
+template<typename Int, unsigned kMode>
+constexpr Rational<Int, kMode> Rational<Int, kMode>::operator+() const {
   return *this;
 }
 
-Rational Rational::operator+(const Rational &other) const {
-  Rational tmp = *this;
-  tmp.numerator_ = tmp.numerator_ * other.denominator_ +
-      other.numerator_ * tmp.denominator_;
-  tmp.denominator_ = denominator_ * other.denominator_;
-  tmp.Normalize();
-  return tmp;
+template<typename Int, unsigned kMode>
+constexpr Rational<Int, kMode>
+Rational<Int, kMode>::operator+(const Rational &other) const {
+  return Add(numerator_, denominator_, other.numerator_, other.denominator_);
 }
 
-Rational Rational::operator+(int num) const {
-  return {numerator_ + num * denominator_, denominator_};
+template<typename Int, unsigned kMode>
+constexpr Rational<Int, kMode>
+Rational<Int, kMode>::operator+(const Int &num) const {
+  return Add(numerator_, denominator_, num, 1);
 }
 
-Rational &Rational::operator+=(const Rational &other) {
+template<typename Int, unsigned kMode>
+constexpr Rational<Int, kMode> &
+Rational<Int, kMode>::operator+=(const Rational &other) {
   *this = *this + other;
   return *this;
 }
 
-Rational operator+(int num, const Rational &other) {
-  return other + num;
+template<typename Int, unsigned kMode>
+constexpr Rational<Int, kMode>
+Rational<Int, kMode>::operator-(const Rational &other) const {
+  return Add(numerator_, denominator_,
+             -Wide(other.numerator_), other.denominator_);
 }
 
-Rational Rational::operator-(const Rational &other) const {
-  return *this + (-other);
+template<typename Int, unsigned kMode>
+constexpr Rational<Int, kMode>
+Rational<Int, kMode>::operator-(const Int &num) const {
+  return Add(numerator_, denominator_, -Wide(num), 1);
 }
 
-Rational Rational::operator-(int num) const {
-  return *this + (-num);
-}
-
-Rational &Rational::operator-=(const Rational &other) {
+template<typename Int, unsigned kMode>
+constexpr Rational<Int, kMode> &
+Rational<Int, kMode>::operator-=(const Rational &other) {
   *this = *this - other;
   return *this;
 }
 
-Rational operator-(int num, const Rational &other) {
-  return -(other - num);
-}
-
-Rational Rational::operator*(const Rational &other) const {
-  Rational tmp = *this;
-  tmp.numerator_ *= other.numerator_;
-  tmp.denominator_ *= other.denominator_;
-  tmp.Normalize();
-  return tmp;
+template<typename Int, unsigned kMode>
+constexpr Rational<Int, kMode>
+Rational<Int, kMode>::operator*(const Rational &other) const {
+  return Multiply(numerator_, denominator_,
+                  other.numerator_, other.denominator_);
 }
 
-Rational Rational::operator*(int num) const {
-  return {numerator_ * num, denominator_};
+template<typename Int, unsigned kMode>
+constexpr Rational<Int, kMode>
+Rational<Int, kMode>::operator*(const Int &num) const {
+  return Multiply(numerator_, denominator_, num, 1);
 }
 
-Rational &Rational::operator*=(const Rational &other) {
+template<typename Int, unsigned kMode>
+constexpr Rational<Int, kMode> &
+Rational<Int, kMode>::operator*=(const Rational &other) {
   *this = *this * other;
   return *this;
 }
 
-Rational operator*(int num, const Rational &other) {
-  return other * num;
-}
-
-Rational Rational::operator/(const Rational &other) const {
-  Rational tmp = other;
-  std::swap(tmp.numerator_, tmp.denominator_);
-  tmp = tmp * (*this);
-  return tmp;
+template<typename Int, unsigned kMode>
+constexpr Rational<Int, kMode>
+Rational<Int, kMode>::operator/(const Rational &other) const {
+  if (other.numerator_ == 0) {
+    throw std::runtime_error("Diving by zero");
+  }
+  Wide numerator = other.denominator_;
+  Wide denominator = other.numerator_;
+  if (denominator < 0) {
+    numerator = -numerator;
+    denominator = -denominator;
+  }
+  return Multiply(numerator_, denominator_, numerator, denominator);
 }
 
-Rational Rational::operator/(int num) const {
-  return {numerator_, denominator_ * num};
+template<typename Int, unsigned kMode>
+constexpr Rational<Int, kMode>
+Rational<Int, kMode>::operator/(const Int &num) const {
+  return *this / Rational(num);
 }
 
-Rational &Rational::operator/=(const Rational &other) {
+template<typename Int, unsigned kMode>
+constexpr Rational<Int, kMode> &
+Rational<Int, kMode>::operator/=(const Rational &other) {
   *this = *this / other;
   return *this;
 }
 
-Rational operator/(int num, const Rational &other) {
-  return {num * other.denominator_, other.numerator_};
-}
-
-bool Rational::operator==(const Rational &other) const {
+template<typename Int, unsigned kMode>
+constexpr bool Rational<Int, kMode>::operator==(const Rational &other) const {
+  if (kMode & kRationalLazy) {
+    return Wide(numerator_) * other.denominator_
+        == Wide(other.numerator_) * denominator_;
+  }
   return numerator_ == other.numerator_ && denominator_ == other.denominator_;
 }
 
-bool Rational::operator!=(const Rational &other) const {
+template<typename Int, unsigned kMode>
+constexpr bool Rational<Int, kMode>::operator!=(const Rational &other) const {
   return !(*this == other);
 }
 
-bool Rational::operator<(const Rational &other) const {
-  return numerator_ * other.denominator_ < other.numerator_ * denominator_;
+template<typename Int, unsigned kMode>
+constexpr bool Rational<Int, kMode>::operator<(const Rational &other) const {
+  return Wide(numerator_) * other.denominator_
+      < Wide(other.numerator_) * denominator_;
 }
 
-bool Rational::operator<=(const Rational &other) const {
-  return *this < other || *this == other;
+template<typename Int, unsigned kMode>
+constexpr bool Rational<Int, kMode>::operator<=(const Rational &other) const {
+  return !(other < *this);
 }
 
-bool Rational::operator>(const Rational &other) const {
+template<typename Int, unsigned kMode>
+constexpr bool Rational<Int, kMode>::operator>(const Rational &other) const {
   return other < *this;
 }
 
-bool Rational::operator>=(const Rational &other) const {
+template<typename Int, unsigned kMode>
+constexpr bool Rational<Int, kMode>::operator>=(const Rational &other) const {
   return other <= *this;
 }
 
+// Value of a std::ratio-like type (anything with static num and den, such
+// as std::milli or StaticRational) as a Rational.
+template<typename Ratio, typename Int = int64_t,
+         unsigned kMode = kRationalDefault>
+constexpr Rational<Int, kMode> kRatioValue =
+    Rational<Int, kMode>(Ratio::num, Ratio::den);
+
+// Fraction fixed at compile time. Like std::ratio it is a type with static
+// num and den members in lowest terms, so the two can be used
+// interchangeably, and it is convertible to std::ratio through Ratio.
+// Arithmetic on it goes through checked Rational<int64_t>, so an
+// overflow is a compile error.
+template<int64_t kNumerator, int64_t kDenominator = 1>
+struct StaticRational {
+  static constexpr Rational<int64_t, kRationalChecked> value{kNumerator,
+                                                            kDenominator};
+  static constexpr int64_t num = value.GetNumerator();
+  static constexpr int64_t den = value.GetDenominator();
+
+  using type = StaticRational<num, den>;
+  using Ratio = std::ratio<num, den>;
+
+  constexpr operator Rational<int64_t>() const {
+    return Rational<int64_t>(num, den);
+  }
+};
+
+template<typename Ratio>
+using ToStaticRational = StaticRational<Ratio::num, Ratio::den>;
+
+// Result of 'kOperation' ('+', '-', '*' or '/') on two std::ratio-like
+// types.
+template<typename Left, typename Right, char kOperation>
+struct StaticRationalArithmetic {
+  using Checked = Rational<int64_t, kRationalChecked>;
+
+  static constexpr Checked kLeft = kRatioValue<Left, int64_t,
+                                               kRationalChecked>;
+  static constexpr Checked kRight = kRatioValue<Right, int64_t,
+                                                kRationalChecked>;
+  static constexpr Checked kResult = kOperation == '+' ? kLeft + kRight
+      : kOperation == '-' ? kLeft - kRight
+      : kOperation == '*' ? kLeft * kRight
+      : kLeft / kRight;
+
+  using type = StaticRational<kResult.GetNumerator(),
+                              kResult.GetDenominator()>;
+};
+
+template<typename Left, typename Right>
+using StaticRationalAdd =
+    typename StaticRationalArithmetic<Left, Right, '+'>::type;
+
+template<typename Left, typename Right>
+using StaticRationalSubtract =
+    typename StaticRationalArithmetic<Left, Right, '-'>::type;
+
+template<typename Left, typename Right>
+using StaticRationalMultiply =
+    typename StaticRationalArithmetic<Left, Right, '*'>::type;
+
+template<typename Left, typename Right>
+using StaticRationalDivide =
+    typename StaticRationalArithmetic<Left, Right, '/'>::type;
+
+// Exact reference for the randomized test: fractions of 128-bit integers
+// reduced to lowest terms.
+struct ReferenceFraction {
+  __int128 numerator;
+  __int128 denominator;
+};
+
+__int128 ReferenceGcd(__int128 a, __int128 b) {
+  a = a < 0 ? -a : a;
+  b = b < 0 ? -b : b;
+  while (b != 0) {
+    __int128 r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+ReferenceFraction MakeReference(__int128 x, __int128 y) {
+  __int128 gcd = ReferenceGcd(x, y);
+  x /= gcd;
+  y /= gcd;
+  if (y < 0) {
+    x = -x;
+    y = -y;
+  }
+  return {x, y};
+}
+
+bool FitsInt(const ReferenceFraction &fraction) {
+  return fraction.numerator >= std::numeric_limits<int>::min()
+      && fraction.numerator <= std::numeric_limits<int>::max()
+      && fraction.denominator <= std::numeric_limits<int>::max();
+}
+
+// Checks that the checked 'result' of an operation equals 'expected', or
+// that the operation threw iff 'expected' does not fit into int.
+template<typename Operation>
+void CheckAgainstReference(const ReferenceFraction &expected,
+                           Operation operation) {
+  bool fits = FitsInt(expected);
+  try {
+    Rational<int, kRationalChecked> result = operation();
+    assert(fits);
+    assert(result.GetNumerator() == expected.numerator);
+    assert(result.GetDenominator() == expected.denominator);
+  } catch (const std::overflow_error &) {
+    assert(!fits);
+  }
+}
+
+std::string Int128ToString(__int128 value) {
+  if (value == 0) {
+    return "0";
+  }
+  bool negative = value < 0;
+  std::string digits;
+  while (value != 0) {
+    int digit = static_cast<int>(value % 10);
+    digits += static_cast<char>('0' + (digit < 0 ? -digit : digit));
+    value /= 10;
+  }
+  if (negative) {
+    digits += '-';
+  }
+  return std::string(digits.rbegin(), digits.rend());
+}
+
+BigInt RandomBigInt(std::mt19937 &generator, size_t limbs) {
+  BigInt result;
+  for (size_t i = 0; i < limbs; ++i) {
+    result = result * BigInt(int64_t(1) << 32) + BigInt(generator());
+  }
+  return generator() % 2 ? -result : result;
+}
+
+// Sum of 1 / i for i in [first, last), added up pairwise so that the
+// operands of each addition have similar sizes.
+template<typename Int, unsigned kMode = kRationalDefault>
+constexpr Rational<Int, kMode> HarmonicSum(int first, int last) {
+  if (last - first == 1) {
+    return Rational<Int, kMode>(1, first);
+  }
+  int middle = first + (last - first) / 2;
+  return HarmonicSum<Int, kMode>(first, middle)
+      + HarmonicSum<Int, kMode>(middle, last);
+}
+
+// The operators from main() over another integer type or mode.
+template<typename Int, unsigned kMode = kRationalDefault>
+void CheckOperators() {
+  using R = Rational<Int, kMode>;
+  R f1(1, 4);
+  R f2(1, 100);
+
+  assert(+f1 == f1);
+  assert(-f1 == f1 * -1);
+  assert(f1 + f2 == R(13, 50));
+  assert(f1 + 2 == R(9, 4));
+  assert(3 + f1 == R(13, 4));
+  assert(f1 - f2 == R(6, 25));
+  assert(2 - f1 == R(7, 4));
+  assert(f1 - 4 == R(-15, 4));
+  assert(f1 * f2 == R(1, 400));
+  assert(2 * f1 == R(1, 2));
+  assert(f1 / f2 == R(25, 1));
+  assert(2 / f1 == R(8, 1));
+  assert(f1 / 5 == R(1, 20));
+  assert((f1 + 1) / -f2 == R(-125, 1));
+  assert(1 / f2 - f1 * 4 == R(99, 1));
+  assert(f1.GetValue() == 0.25);
+  assert(f1 != f2 && f1 > f2 && f1 >= f2 && f2 < f1 && f2 <= f1);
+  assert(R(2, -6) == R(-1, 3));
+
+  f1 += f2;
+  assert(f1 == R(13, 50));
+  f1 -= f2;
+  f1 -= f2;
+  assert(f1 == R(6, 25));
+  f1 *= f2;
+  assert(f1 == R(6, 2500));
+  f1 /= f2;
+  assert(f1 == R(6, 25));
+
+  R harmonic;
+  for (int i = 1; i <= 20; ++i) {
+    harmonic += R(1, i);
+  }
+  assert(harmonic == R(55835135, 15519504));
+  assert(harmonic == (HarmonicSum<Int, kMode>(1, 21)));
+}
+
+// Compile-time tests: a static_assert only compiles if its condition was
+// folded by the compiler.
+static_assert(Gcd(0, 7) == 7 && Gcd(12, 18) == 6 && Gcd(17, 5) == 1);
+static_assert(Gcd(int64_t(1) << 40, int64_t(3) << 35) == int64_t(1) << 35);
+static_assert(Gcd(__int128(6) << 80, __int128(4) << 80)
+              == __int128(2) << 80);
+
+static_assert(Rational(2, -6) == Rational(-1, 3));
+static_assert(Rational(2, -6).GetNumerator() == -1
+              && Rational(2, -6).GetDenominator() == 3);
+static_assert(Rational(1, 4) + Rational(1, 100) == Rational(13, 50));
+static_assert(2 - Rational(1, 4) == Rational(7, 4));
+static_assert(Rational(1, 4) * 3 == Rational(3, 4));
+static_assert(2 / Rational(1, 4) == Rational(8, 1));
+static_assert(-Rational(1, 4) < Rational(1, 100));
+static_assert(Rational(1, 4).GetValue() == 0.25);
+static_assert(HarmonicSum<int>(1, 21) == Rational(55835135, 15519504));
+static_assert(HarmonicSum<int64_t, kRationalLazy | kRationalChecked>(1, 31)
+              .GetDenominator() == HarmonicSum<int64_t>(1, 31)
+                                       .GetDenominator());
+static_assert([] {
+  Rational<int64_t, kRationalLazy> product(1);
+  for (int i = 2; i <= 20; ++i) {
+    product *= Rational<int64_t, kRationalLazy>(i, i + 1);
+  }
+  return product.GetDenominator();
+}() == 21);
+
+// Meters per inch, foot, yard and mile, and a table of conversion factors
+// between them, all computed at compile time.
+constexpr Rational<int64_t> kMetersPerUnit[] = {
+    Rational<int64_t>(254, 10000),
+    Rational<int64_t>(3048, 10000),
+    Rational<int64_t>(9144, 10000),
+    Rational<int64_t>(1609344, 1000),
+};
+constexpr int kUnits = sizeof(kMetersPerUnit) / sizeof(kMetersPerUnit[0]);
+
+struct ConversionTable {
+  Rational<int64_t> factor[kUnits][kUnits];
+};
+
+constexpr ConversionTable MakeConversionTable() {
+  ConversionTable table{};
+  for (int from = 0; from < kUnits; ++from) {
+    for (int to = 0; to < kUnits; ++to) {
+      table.factor[from][to] = kMetersPerUnit[from] / kMetersPerUnit[to];
+    }
+  }
+  return table;
+}
+
+constexpr ConversionTable kConversion = MakeConversionTable();
+static_assert(kConversion.factor[1][0] == Rational<int64_t>(12));
+static_assert(kConversion.factor[3][2] == Rational<int64_t>(1760));
+static_assert(kConversion.factor[0][3] == Rational<int64_t>(1, 63360));
+static_assert(kConversion.factor[2][2] == Rational<int64_t>(1));
+
+// Interoperation with std::ratio.
+static_assert(StaticRational<3, -6>::num == -1
+              && StaticRational<3, -6>::den == 2);
+static_assert(std::is_same_v<StaticRational<2, 4>::type,
+                             StaticRational<1, 2>>);
+static_assert(std::is_same_v<StaticRational<2, 4>::Ratio, std::ratio<1, 2>>);
+static_assert(std::is_same_v<ToStaticRational<std::milli>,
+                             StaticRational<1, 1000>>);
+static_assert(kRatioValue<std::micro> == Rational<int64_t>(1, 1'000'000));
+static_assert(kRatioValue<std::ratio<6, 4>, int> == Rational(3, 2));
+static_assert(std::is_same_v<StaticRationalAdd<std::milli, std::centi>,
+                             StaticRational<11, 1000>>);
+static_assert(std::is_same_v<
+    StaticRationalSubtract<StaticRational<1, 3>, std::ratio<1, 6>>::Ratio,
+    std::ratio_subtract<std::ratio<1, 3>, std::ratio<1, 6>>::type>);
+static_assert(std::is_same_v<StaticRationalMultiply<std::kilo, std::milli>,
+                             StaticRational<1>>);
+static_assert(std::is_same_v<StaticRationalDivide<std::mega, std::kilo>,
+                             ToStaticRational<std::kilo>>);
+static_assert(Rational<int64_t>(StaticRational<5, 10>())
+              == kRatioValue<std::ratio<1, 2>>);
+
 int main() {
   Rational f1{1, 4};
   Rational f2(1, 100);
@@ -251,5 +1309,303 @@ int main() {
   //throwing an exception
   //f1 / f5;
 
+  // Products and cross-multiplications that overflow int but whose
+  // results fit.
+  const int kMax = std::numeric_limits<int>::max();
+  const int kMin = std::numeric_limits<int>::min();
+  assert(Rational(kMax, 2) * Rational(2, kMax) == Rational(1));
+  assert(Rational(1, kMax - 1) + Rational(1, kMax - 1)
+             == Rational(1, (kMax - 1) / 2));
+  assert(Rational(kMax, kMax - 1) < Rational(kMax - 1, kMax - 2));
+  assert(Rational(kMax - 1, kMax) < Rational(kMax, kMax - 1));
+  assert(Rational(kMin, 2) / Rational(kMin, 4) == Rational(2));
+  assert(Rational(4, kMin).GetNumerator() == -1);
+
+  bool thrown = false;
+  try {
+    Rational<int, kRationalChecked>(kMax) + 1;
+  } catch (const std::overflow_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+  thrown = false;
+  try {
+    -Rational<int, kRationalChecked>(kMin);
+  } catch (const std::overflow_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  std::mt19937 generator(2018);
+  for (int i = 0; i < 200000; ++i) {
+    // Both huge and small values, so that results often fit after
+    // reduction and often do not.
+    int bits = 1 + i % 31;
+    auto random_int = [&](bool non_zero) {
+      int value;
+      do {
+        value = static_cast<int>(generator()) >> (32 - bits);
+      } while (non_zero && value == 0);
+      return value;
+    };
+    ReferenceFraction lhs = MakeReference(random_int(false),
+                                          random_int(true));
+    ReferenceFraction rhs = MakeReference(random_int(false),
+                                          random_int(true));
+    if (!FitsInt(lhs) || !FitsInt(rhs)) {
+      continue;
+    }
+    using Checked = Rational<int, kRationalChecked>;
+    Checked a(static_cast<int>(lhs.numerator),
+              static_cast<int>(lhs.denominator));
+    Checked b(static_cast<int>(rhs.numerator),
+              static_cast<int>(rhs.denominator));
+    __int128 an = lhs.numerator, ad = lhs.denominator;
+    __int128 bn = rhs.numerator, bd = rhs.denominator;
+    CheckAgainstReference(MakeReference(an * bd + bn * ad, ad * bd),
+                          [&] { return a + b; });
+    CheckAgainstReference(MakeReference(an * bd - bn * ad, ad * bd),
+                          [&] { return a - b; });
+    CheckAgainstReference(MakeReference(an * bn, ad * bd),
+                          [&] { return a * b; });
+    if (bn != 0) {
+      CheckAgainstReference(MakeReference(an * bd, ad * bn),
+                            [&] { return a / b; });
+    }
+    assert((a < b) == (an * bd < bn * ad));
+    assert((a == b) == (an * bd == bn * ad));
+  }
+
+  CheckOperators<int>();
+  CheckOperators<int64_t>();
+  CheckOperators<BigInt>();
+  CheckOperators<int, kRationalLazy>();
+  CheckOperators<int64_t, kRationalLazy | kRationalChecked>();
+
+  // Rational<int64_t> keeps products in __int128.
+  const int64_t kMax64 = std::numeric_limits<int64_t>::max();
+  assert(Rational<int64_t>(kMax64, 3) * Rational<int64_t>(3, kMax64)
+             == Rational<int64_t>(1));
+  assert(Rational<int64_t>(kMax64 - 1, kMax64)
+             < Rational<int64_t>(kMax64, kMax64 - 1));
+  thrown = false;
+  try {
+    Rational<int64_t, kRationalChecked> harmonic;
+    for (int i = 1; i <= 100; ++i) {
+      harmonic += Rational<int64_t, kRationalChecked>(1, i);
+    }
+  } catch (const std::overflow_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // BigInt against __int128 on values of up to 62 bits.
+  for (int i = 0; i < 100000; ++i) {
+    int bits = 1 + i % 62;
+    auto random_value = [&] {
+      int64_t value = static_cast<int64_t>(
+          (uint64_t(generator()) << 32 | generator()) >> (64 - bits));
+      return generator() % 2 ? -value : value;
+    };
+    int64_t x = random_value();
+    int64_t y = random_value();
+    BigInt a(x);
+    BigInt b(y);
+    __int128 wide_x = x;
+    assert(a.ToString() == std::to_string(x));
+    assert((a + b).ToString() == Int128ToString(wide_x + y));
+    assert((a - b).ToString() == Int128ToString(wide_x - y));
+    assert((a * b).ToString() == Int128ToString(wide_x * y));
+    assert((a < b) == (x < y) && (a == b) == (x == y));
+    if (y != 0) {
+      assert((a / b).ToString() == std::to_string(x / y));
+      assert((a % b).ToString() == std::to_string(x % y));
+      assert(Gcd(a, b).ToString()
+                 == Int128ToString(ReferenceGcd(x, y)));
+    }
+  }
+  BigInt power(1);
+  BigInt factorial(1);
+  for (int i = 1; i <= 100; ++i) {
+    power *= 2;
+    if (i <= 30) {
+      factorial *= i;
+    }
+  }
+  assert(power.ToString() == "1267650600228229401496703205376");
+  assert(factorial.ToString() == "265252859812191058636308480000000");
+  assert(-factorial / power == BigInt(-209));
+  assert(-power / factorial == BigInt(0));
+  assert(-factorial % power == -(factorial - 209 * power));
+  assert(factorial % 1000 == 0 && factorial % 1001 == 0);
+
+  // Operands long enough for Karatsuba and long division.
+  for (size_t limbs : {1, 5, 31, 40, 100, 333}) {
+    BigInt a = RandomBigInt(generator, limbs);
+    BigInt b = RandomBigInt(generator, limbs / 2 + 1);
+    BigInt c = RandomBigInt(generator, limbs + 7);
+    assert((a + b) * (a + b) == a * a + 2 * a * b + b * b);
+    assert(a * (b + c) == a * b + a * c);
+    assert(a * b * c / (a * b) == c);
+    BigInt small = Abs(b) % Abs(c);
+    assert((Abs(a) * Abs(c) + small) / Abs(c) == Abs(a));
+    assert((Abs(a) * Abs(c) + small) % Abs(c) == small);
+    BigInt quotient = c / b;
+    BigInt remainder = c % b;
+    assert(quotient * b + remainder == c);
+    assert(Abs(remainder) < Abs(b));
+    assert(Gcd(a * c, b * c) == Gcd(a, b) * Abs(c));
+  }
+
+  // Exact accumulation beyond the range of built-in integers.
+  Rational<BigInt> harmonic;
+  for (int i = 1; i <= 100; ++i) {
+    harmonic += Rational<BigInt>(1, i);
+  }
+  assert(harmonic == HarmonicSum<BigInt>(1, 101));
+  assert(std::abs(harmonic.GetValue() - 5.187377517639621) < 1e-12);
+  assert(harmonic.GetDenominator() > BigInt(kMax64) * BigInt(kMax64));
+
+  // Binary GCD against Euclid's algorithm.
+  for (int i = 0; i < 100000; ++i) {
+    int64_t x = static_cast<int64_t>(uint64_t(generator()) << (i % 21))
+        * (1 + generator() % 1000);
+    int64_t y = static_cast<int64_t>(generator() >> (i % 32))
+        * (1 + generator() % 1000);
+    assert(Gcd(x, y) == ReferenceGcd(x, y));
+    assert(Gcd(__int128(x) * y, __int128(y)) == y);
+  }
+
+  // Lazy normalization gives the same results, overflows included.
+  for (int i = 0; i < 1000; ++i) {
+    using Eager = Rational<int, kRationalChecked>;
+    using Lazy = Rational<int, kRationalChecked | kRationalLazy>;
+    Eager eager(1);
+    Lazy lazy(1);
+    for (int step = 0; step < 100; ++step) {
+      int numerator = static_cast<int>(generator() % 2001) - 1000;
+      int denominator = 1 + generator() % (i % 2 ? 12 : 1000);
+      Eager eager_term(numerator, denominator);
+      Lazy lazy_term(numerator, denominator);
+      bool eager_thrown = false;
+      bool lazy_thrown = false;
+      Eager eager_result;
+      Lazy lazy_result;
+      int operation = generator() % 4;
+      try {
+        eager_result = operation == 0 ? eager + eager_term
+            : operation == 1 ? eager - eager_term
+            : operation == 2 ? eager * eager_term
+            : numerator != 0 ? eager / eager_term : eager;
+      } catch (const std::overflow_error &) {
+        eager_thrown = true;
+      }
+      try {
+        lazy_result = operation == 0 ? lazy + lazy_term
+            : operation == 1 ? lazy - lazy_term
+            : operation == 2 ? lazy * lazy_term
+            : numerator != 0 ? lazy / lazy_term : lazy;
+      } catch (const std::overflow_error &) {
+        lazy_thrown = true;
+      }
+      assert(eager_thrown == lazy_thrown);
+      if (eager_thrown) {
+        break;
+      }
+      eager = eager_result;
+      lazy = lazy_result;
+      assert(lazy.GetNumerator() == eager.GetNumerator());
+      assert(lazy.GetDenominator() == eager.GetDenominator());
+      assert(lazy.GetValue() == eager.GetValue());
+      assert((lazy < lazy_term) == (eager < eager_term));
+      assert((lazy == lazy_term) == (eager == eager_term));
+    }
+  }
+
+  // Without kRationalChecked an overflowed denominator wraps around to a
+  // negative value, as before, and later operations still terminate.
+  {
+    Rational<int> eager = Rational(1, 46341) * Rational(1, 46341);
+    assert(eager.GetNumerator() == 1);
+    assert(eager.GetDenominator() == -2147479015);
+    eager = eager + Rational(1, 3) - Rational(2, 7);
+    assert(eager.GetNumerator() == -2147478994);
+    assert(eager.GetDenominator() == -2147386355);
+
+    using Lazy = Rational<int, kRationalLazy>;
+    Lazy lazy = Lazy(1, 46341) * Lazy(1, 46341);
+    assert(lazy.GetDenominator() == -2147479015);
+    lazy = lazy + Lazy(1, 3) - Lazy(2, 7);
+    assert(lazy.GetValue() == eager.GetValue());
+
+    Rational<int64_t> wide = Rational<int64_t>(1, 3037000500)
+        * Rational<int64_t>(1, 3037000500) + Rational<int64_t>(1, 3);
+    assert(wide.GetNumerator() == -9223372036709301613);
+    assert(wide.GetDenominator() == -9223372036418353232);
+  }
+
+#ifdef RUN_BENCHMARKS
+  {
+    const int kTerms = 100'000;
+    auto measure = [](auto function) {
+      auto start = std::chrono::steady_clock::now();
+      function();
+      std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::steady_clock::now() - start;
+      return elapsed.count();
+    };
+    Rational<BigInt> sequential;
+    double sequential_elapsed = measure([&] {
+      for (int i = 1; i <= kTerms; ++i) {
+        sequential += Rational<BigInt>(1, i);
+      }
+    });
+    Rational<BigInt> pairwise;
+    double pairwise_elapsed = measure([&] {
+      pairwise = HarmonicSum<BigInt>(1, kTerms + 1);
+    });
+    assert(sequential == pairwise);
+    int64_t exponent;
+    sequential.GetDenominator().Frexp(&exponent);
+    std::cout << "[BENCH] Harmonic sum of " << kTerms << " terms = "
+              << sequential.GetValue() << " (denominator of " << exponent
+              << " bits): sequential " << sequential_elapsed
+              << " ms, pairwise " << pairwise_elapsed << " ms" << std::endl;
+  }
+  {
+    // Ledger-style accumulation: amounts with a few small denominators.
+    const int kTerms = 10'000'000;
+    const int kDenominators[] = {100, 8, 3, 1000};
+    auto measure = [](auto function) {
+      auto start = std::chrono::steady_clock::now();
+      function();
+      std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::steady_clock::now() - start;
+      return elapsed.count();
+    };
+    auto accumulate = [&](auto sum) {
+      using R = decltype(sum);
+      for (int i = 0; i < kTerms; ++i) {
+        sum += R(static_cast<int>((i * 7919LL) % 20001) - 10000,
+                 kDenominators[i % 4]);
+      }
+      return sum;
+    };
+    Rational<int64_t> eager;
+    double eager_elapsed = measure([&] {
+      eager = accumulate(Rational<int64_t>());
+    });
+    Rational<int64_t, kRationalLazy> lazy;
+    double lazy_elapsed = measure([&] {
+      lazy = accumulate(Rational<int64_t, kRationalLazy>());
+    });
+    assert(lazy.GetNumerator() == eager.GetNumerator());
+    assert(lazy.GetDenominator() == eager.GetDenominator());
+    std::cout << "[BENCH] Accumulation of " << kTerms << " terms: eager "
+              << eager_elapsed << " ms, lazy " << lazy_elapsed << " ms"
+              << std::endl;
+  }
+#endif  // RUN_BENCHMARKS
+
   return 0;
 }
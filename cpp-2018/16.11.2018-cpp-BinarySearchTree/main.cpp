@@ -1,60 +1,285 @@
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEARCH_TREE_SIMD_X86
+#include <immintrin.h>
+#endif
+
 // Бинарное поисковое дерево.
+// Дерево сбалансировано по высоте (АВЛ-дерево): высоты поддеревьев любой
+// вершины отличаются не более чем на единицу, поэтому высота дерева из n
+// элементов не превосходит 1.44 * log2(n + 2), и все операции выполняются
+// за O(log n) в худшем случае, в том числе при добавлении
+// отсортированной последовательности.
+// Вершины выделяются блоками из пула, принадлежащего дереву; удалённые
+// вершины переиспользуются, а всё дерево освобождается разом. Деревья,
+// полученные друг из друга через Split, делят один пул, поэтому их
+// нельзя изменять одновременно из разных потоков.
+// Каждая вершина хранит размер своего поддерева, что позволяет отвечать
+// на запросы порядковых статистик за O(log n).
+//
+// Ключи типа 'Key' упорядочиваются компаратором 'Compare'. Если 'Mapped'
+// отличен от void, к каждому ключу прилагается значение этого типа, и
+// дерево становится (мульти)отображением, см. BinarySearchMap. Ключи
+// скалярных типов передаются по значению, поэтому BinarySearchTree<int>
+// компилируется в тот же код, что и дерево, написанное для int.
+// Если компаратор прозрачный (содержит тип is_transparent, как
+// std::less<>), Contains принимает любой сравнимый с ключом тип, например
+// std::string_view для ключей std::string, без создания временного ключа.
+template<typename Key, typename Compare = std::less<Key>,
+         typename Mapped = void>
 class BinarySearchTree {
  public:
+  // Тип, которым ключ передаётся в методы.
+  using KeyParam =
+      std::conditional_t<std::is_scalar_v<Key>, Key, const Key&>;
+
+  // Двунаправленный итератор по элементам дерева в порядке неубывания.
+  // Переходит к соседней вершине по указателям на предков и не использует
+  // дополнительной памяти. Действителен до удаления его элемента;
+  // перемещение дерева делает недействительным итератор end().
+  class ConstIterator;
+
+  // Диапазон элементов [begin(), end()) для использования в range-for.
+  class Range;
+
   // Конструктор.
   // Инициализирует значения полей 'root_' и 'size_'.
-  BinarySearchTree();
+  explicit BinarySearchTree(const Compare& compare = Compare());
 
   // Деструктор.
-  // Удаляет все элменты дерева путём удаления корневой вершины.
+  // Освобождает все блоки пула вершин. Вершины с нетривиальными
+  // деструкторами предварительно разрушаются обходом без рекурсии.
   ~BinarySearchTree();
 
+  BinarySearchTree(const BinarySearchTree&) = delete;
+  BinarySearchTree& operator=(const BinarySearchTree&) = delete;
+
+  // Перемещение забирает вершины вместе с пулом; 'other' остаётся пустым.
+  BinarySearchTree(BinarySearchTree&& other) noexcept;
+  BinarySearchTree& operator=(BinarySearchTree&& other) noexcept;
+
   // Возвращает количество элементов в дереве.
   size_t Size() const;
 
+  // Возвращает высоту дерева (0 для пустого дерева).
+  int Height() const;
+
   // Метод возвращает "true" если элемент со значением 'value' имеется в дереве
   // поиска и "false" в противном случае.
-  bool Contains(int value) const;
+  bool Contains(KeyParam value) const;
+
+  // То же для прозрачного компаратора: 'value' сравнивается с ключами
+  // напрямую, без преобразования в Key.
+  template<typename K, typename C = Compare,
+           typename = typename C::is_transparent>
+  bool Contains(const K& value) const;
+
+  // Записывает в out[i], имеется ли в дереве элемент keys[i], для всех
+  // i < count. Спуски для разных ключей чередуются (AMAC): пока вершина
+  // одного ключа загружается из памяти, продвигаются остальные, поэтому
+  // на деревьях, не помещающихся в кэш, время упирается в пропускную
+  // способность памяти, а не в задержку каждого промаха.
+  void ContainsBatch(const Key* keys, size_t count, bool* out) const;
 
   // Помещает значение 'value' в поисковое дерево.
-  void Add(int value);
+  void Add(KeyParam value);
+
+  // Помещает ключ 'value' с прилагаемым значением 'mapped' в дерево.
+  // Доступен только для отображений.
+  template<typename M = Mapped,
+           typename = std::enable_if_t<!std::is_void_v<M>>>
+  void Add(KeyParam value, const M& mapped);
+
+  // Возвращает указатель на значение, приложенное к одному из ключей,
+  // равных 'value', либо nullptr. Доступен только для отображений.
+  template<typename M = Mapped>
+  std::enable_if_t<!std::is_void_v<M>, M*> Get(KeyParam value);
+  template<typename M = Mapped>
+  std::enable_if_t<!std::is_void_v<M>, const M*> Get(KeyParam value) const;
 
   // Удаляет элемент со значением 'value' из поискового дерева.
   // Если элементов с таким значением несколько, удаляется лишь одно из них.
-  void Erase(int value);
+  void Erase(KeyParam value);
 
   // Возвращает массив из элементов, содержащихся в дереве поиска,
   // расположенными в порядке неубывания.
-  std::vector<int> ToSortedArray() const;
+  std::vector<Key> ToSortedArray() const;
+
+  // Итераторы на наименьший элемент и на позицию за наибольшим.
+  ConstIterator begin() const;
+  ConstIterator end() const;
+
+  // Итератор на первый элемент, не меньший (LowerBound) или больший
+  // (UpperBound) 'value', либо end().
+  ConstIterator LowerBound(KeyParam value) const;
+  ConstIterator UpperBound(KeyParam value) const;
+
+  // Возвращает количество элементов, строго меньших 'value'.
+  size_t Rank(KeyParam value) const;
+
+  // Возвращает k-й по возрастанию элемент (нумерация с нуля).
+  // Требует k < Size().
+  const Key& KthSmallest(size_t k) const;
+
+  // Возвращает количество элементов из отрезка [lo, hi].
+  size_t CountInRange(KeyParam lo, KeyParam hi) const;
+
+  // Возвращает диапазон элементов из отрезка [lo, hi] в порядке
+  // неубывания. Элементы не копируются; диапазон действителен до
+  // изменения дерева.
+  Range GetRange(KeyParam lo, KeyParam hi) const;
+
+  // Удаляет все элементы дерева за время, пропорциональное числу
+  // блоков пула, а не числу элементов (если ключи и значения
+  // тривиально разрушаемы и пул не разделён с другим деревом).
+  void Clear();
+
+  // Заменяет содержимое дерева элементами [first, last), упорядоченными
+  // по неубыванию. Строит идеально сбалансированное дерево за O(n),
+  // выделяя вершины в порядке обхода.
+  template<typename It>
+  void BuildFromSorted(It first, It last);
+
+  // Переносит все элементы 'other' в данное дерево; 'other' становится
+  // пустым. Объединение строится рекурсивными Split и Join за
+  // O(m log(n / m + 1)), где m - размер меньшего дерева; если все ключи
+  // одного дерева не больше всех ключей другого, одним Join за O(log n).
+  // Блоки пула 'other' переходят к данному дереву без копирования вершин.
+  void Merge(BinarySearchTree& other);
+
+  // Оставляет в дереве элементы, меньшие 'value', и возвращает дерево из
+  // остальных элементов за O(log n). Вершины не переносятся, поэтому оба
+  // дерева продолжают делить один пул: изменять их из разных потоков
+  // без общей блокировки нельзя, а память пула освобождается, лишь когда
+  // разрушены (или слиты в третье дерево) оба. Чтобы получить
+  // независимое дерево, слейте результат в новое дерево, пока пул ещё
+  // разделён: Merge тогда скопирует вершины.
+  BinarySearchTree Split(KeyParam value);
+
+  // Записывает ключи дерева в поток 'out' в компактном двоичном формате
+  // (см. WriteSortedKeys), пригодном для MappedSortedKeys и
+  // BuildFromSorted. Доступно для целочисленных ключей.
+  void Serialize(std::ostream& out) const;
 
  protected:
+  // Заменитель значения для деревьев без прилагаемых значений.
+  struct NoMapped {};
+
+  using MappedStorage =
+      std::conditional_t<std::is_void_v<Mapped>, NoMapped, Mapped>;
+
   // Вершина в дереве поиска.
   struct Node {
-    int value;
+    Key value;
+    [[no_unique_address]] MappedStorage mapped;
+    // Высота поддерева с корнем в данной вершине; у листа равна 1.
+    int height;
+    // Количество вершин в поддереве с корнем в данной вершине.
+    size_t size;
     Node* parent;
     Node* left;
     Node* right;
 
-    // Конструктор, принимающий значение и указатель на предка.
-    Node(int value, Node* parent);
+    // Конструктор, принимающий значение, прилагаемое к нему значение
+    // и указатель на предка.
+    Node(KeyParam value, const MappedStorage& mapped, Node* parent);
+  };
+
+  // Пул вершин. Память запрашивается блоками, размер которых удваивается
+  // от kMinSlabNodes до kMaxSlabNodes вершин; освобождённые вершины
+  // разрушаются, а их память связывается в список и выдаётся повторно.
+  // Clear() лишь возвращает блоки: живые вершины к этому моменту должны
+  // быть разрушены (или быть тривиально разрушаемыми).
+  class NodePool {
+   public:
+    NodePool();
+    ~NodePool();
+
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    Node* Create(KeyParam value, const MappedStorage& mapped, Node* parent);
+    void Destroy(Node* node);
 
-    // Деструктор, удаляющий левое и правое поддеревья при удалении
-    // данной вершины.
-    ~Node();
+    // Освобождает все вершины разом.
+    void Clear();
+
+    // Забирает все блоки и свободные ячейки 'other'. Если у пула есть
+    // свои блоки, свободный хвост последнего блока 'other' не используется
+    // до освобождения пула.
+    void Adopt(NodePool* other);
+
+   private:
+    static constexpr size_t kMinSlabNodes = 64;
+    static constexpr size_t kMaxSlabNodes = 64 * 1024;
+
+    struct Slab {
+      Node* nodes;
+      size_t capacity;
+    };
+
+    // Свободная ячейка пула.
+    struct FreeSlot {
+      FreeSlot* next;
+    };
+
+    static_assert(sizeof(FreeSlot) <= sizeof(Node)
+                      && alignof(FreeSlot) <= alignof(Node),
+                  "a free slot must fit into a node");
+
+    std::vector<Slab> slabs_;
+    // Количество выданных вершин последнего блока.
+    size_t used_in_last_slab_;
+    FreeSlot* free_list_;
   };
 
   Node* root_;
   size_t size_;
+  // Создаётся при первой вставке; может быть общим с деревьями,
+  // полученными через Split.
+  std::shared_ptr<NodePool> pool_;
+  [[no_unique_address]] Compare compare_;
+
+  // Возвращает пул вершин, создавая его при необходимости.
+  NodePool& GetPool();
 
   // Вспомогательный метод, возвращающий указатель на одну из вершин со
   // значением 'value' (любую из них), либо nullptr при отсутствии таких вершин.
-  Node* Find(int value) const;
+  template<typename K>
+  Node* Find(const K& value) const;
+
+  // Помещает в дерево ключ 'value' с прилагаемым значением 'mapped'.
+  void Insert(KeyParam value, const MappedStorage& mapped);
 
   // Вспомогательные методы, которые позволяют получать указатели на самую
   // левую и самую правую вершины в поддереве, образуемом вершиной node,
@@ -65,73 +290,499 @@ class BinarySearchTree {
   // Связывает предка first_node и вершину second_node
   void ReplacePointers(Node* first_node, Node* second_node);
 
-  // Вспомогательный метод, дописывающий все элементы в поддереве, образуемом
-  // вершиной node, в конец вектора *res в порядке неубывания хранимых значений.
-  void AppendToSortedArray(Node* node, std::vector<int>* res) const;
+  // Высота поддерева с корнем в node (0 для nullptr).
+  static int GetHeight(const Node* node);
+
+  // Размер поддерева с корнем в node (0 для nullptr).
+  static size_t GetSize(const Node* node);
+
+  // Пересчитывает высоту и размер поддерева node по данным детей.
+  static void UpdateNode(Node* node);
+
+  // Первая вершина, значение которой не меньше (при strict == true -
+  // больше) 'value', либо nullptr.
+  const Node* LowerBoundNode(KeyParam value, bool strict) const;
+
+  // Количество элементов, меньших (при inclusive == true - не больших)
+  // 'value'.
+  size_t CountLess(KeyParam value, bool inclusive) const;
+
+  // Следующая и предыдущая в порядке обхода вершины либо nullptr.
+  static const Node* GetNextNode(const Node* node);
+  static const Node* GetPreviousNode(const Node* node);
+
+  // Подсказывает процессору загрузить вершину в кэш заранее.
+  static void PrefetchNode(const Node* node);
+
+  // Малые повороты вокруг вершины node; возвращают новый корень поддерева.
+  Node* RotateLeft(Node* node);
+  Node* RotateRight(Node* node);
+
+  // Восстанавливает баланс на пути от вершины node до корня.
+  void Rebalance(Node* node);
+
+  // Разрушает все вершины дерева, если у них нетривиальные деструкторы
+  // или пул разделён с другим деревом (тогда вершины возвращаются в пул).
+  // Обход выполняется поворотами без рекурсии и дополнительной памяти.
+  void DestroyNodes();
+
+  // Строит идеально сбалансированное поддерево из 'count' вершин,
+  // которые по порядку возвращает 'next_node'.
+  template<typename NextNode>
+  static Node* BuildBalanced(size_t count, NextNode& next_node);
+
+  // Отцепляет вершину от предка и возвращает её.
+  static Node* Detach(Node* node);
+
+  // Соединяет поддеревья 'left' и 'right' через вершину 'middle', все
+  // ключи 'left' не больше, а все ключи 'right' не меньше её ключа.
+  // Корни аргументов должны быть отцеплены; возвращает корень результата.
+  Node* Join(Node* left, Node* middle, Node* right);
+
+  // Разделяет отцепленное поддерево 'node' на ключи, меньшие 'value',
+  // и остальные.
+  void SplitSubtree(Node* node, KeyParam value, Node** left, Node** right);
+
+  // Объединяет два отцепленных поддерева.
+  Node* Unite(Node* first, Node* second);
+
+  // Отцепляет самую левую вершину поддерева 'node', записывает её в
+  // *leftmost и возвращает корень остатка. Работает за O(log n): цепочка
+  // Join вдоль левого края стоит суммы разностей высот.
+  Node* RemoveLeftmost(Node* node, Node** leftmost);
 };
 
-BinarySearchTree::Node::Node(int value, BinarySearchTree::Node* parent)
+// Дерево, в котором к каждому ключу приложено значение типа 'Mapped'.
+template<typename Key, typename Mapped, typename Compare = std::less<Key>>
+using BinarySearchMap = BinarySearchTree<Key, Compare, Mapped>;
+
+template<typename Key, typename Compare, typename Mapped>
+BinarySearchTree<Key, Compare, Mapped>::Node::Node(
+    KeyParam value, const MappedStorage& mapped, Node* parent)
     : value(value),
+      mapped(mapped),
+      height(1),
+      size(1),
       parent(parent),
       left(nullptr),
       right(nullptr) {}
 
-BinarySearchTree::Node::~Node() {
-  delete left;
-  delete right;
+template<typename Key, typename Compare, typename Mapped>
+class BinarySearchTree<Key, Compare, Mapped>::ConstIterator {
+ public:
+  using iterator_category = std::bidirectional_iterator_tag;
+  using value_type = Key;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const Key*;
+  using reference = const Key&;
+
+  ConstIterator();
+
+  const Key& operator*() const;
+  const Key* operator->() const;
+
+  // Значение, приложенное к текущему ключу. Доступно только для
+  // отображений.
+  template<typename M = Mapped>
+  const std::enable_if_t<!std::is_void_v<M>, M>& GetMapped() const;
+
+  ConstIterator& operator++();
+  ConstIterator operator++(int);
+
+  ConstIterator& operator--();
+  ConstIterator operator--(int);
+
+  bool operator==(const ConstIterator& other) const;
+  bool operator!=(const ConstIterator& other) const;
+
+ private:
+  friend class BinarySearchTree;
+
+  ConstIterator(const Node* node, const BinarySearchTree* tree);
+
+  // Текущая вершина; nullptr у итератора за последним элементом.
+  const Node* node_;
+  // Дерево, по которому идёт обход; нужно, чтобы шагнуть назад от end().
+  const BinarySearchTree* tree_;
+};
+
+template<typename Key, typename Compare, typename Mapped>
+class BinarySearchTree<Key, Compare, Mapped>::Range {
+ public:
+  ConstIterator begin() const;
+  ConstIterator end() const;
+
+ private:
+  friend class BinarySearchTree;
+
+  Range(ConstIterator first, ConstIterator last);
+
+  ConstIterator first_;
+  ConstIterator last_;
+};
+
+template<typename Key, typename Compare, typename Mapped>
+BinarySearchTree<Key, Compare, Mapped>::ConstIterator::ConstIterator()
+    : node_(nullptr),
+      tree_(nullptr) {}
+
+template<typename Key, typename Compare, typename Mapped>
+BinarySearchTree<Key, Compare, Mapped>::ConstIterator::ConstIterator(
+    const Node* node, const BinarySearchTree* tree)
+    : node_(node),
+      tree_(tree) {}
+
+template<typename Key, typename Compare, typename Mapped>
+const Key&
+BinarySearchTree<Key, Compare, Mapped>::ConstIterator::operator*() const {
+  assert(node_ != nullptr);
+  return node_->value;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+const Key*
+BinarySearchTree<Key, Compare, Mapped>::ConstIterator::operator->() const {
+  return &**this;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+template<typename M>
+const std::enable_if_t<!std::is_void_v<M>, M>&
+BinarySearchTree<Key, Compare, Mapped>::ConstIterator::GetMapped() const {
+  assert(node_ != nullptr);
+  return node_->mapped;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::ConstIterator&
+BinarySearchTree<Key, Compare, Mapped>::ConstIterator::operator++() {
+  assert(node_ != nullptr);
+  node_ = GetNextNode(node_);
+  return *this;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::ConstIterator
+BinarySearchTree<Key, Compare, Mapped>::ConstIterator::operator++(int) {
+  ConstIterator copy = *this;
+  ++*this;
+  return copy;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::ConstIterator&
+BinarySearchTree<Key, Compare, Mapped>::ConstIterator::operator--() {
+  if (node_ == nullptr) {
+    assert(tree_ != nullptr && tree_->root_ != nullptr);
+    node_ = tree_->GetRightmostNode(tree_->root_);
+  } else {
+    node_ = GetPreviousNode(node_);
+    assert(node_ != nullptr);
+  }
+  return *this;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::ConstIterator
+BinarySearchTree<Key, Compare, Mapped>::ConstIterator::operator--(int) {
+  ConstIterator copy = *this;
+  --*this;
+  return copy;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+bool BinarySearchTree<Key, Compare, Mapped>::ConstIterator::operator==(
+    const ConstIterator& other) const {
+  return node_ == other.node_;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+bool BinarySearchTree<Key, Compare, Mapped>::ConstIterator::operator!=(
+    const ConstIterator& other) const {
+  return node_ != other.node_;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+BinarySearchTree<Key, Compare, Mapped>::Range::Range(ConstIterator first,
+                                                     ConstIterator last)
+    : first_(first),
+      last_(last) {}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::ConstIterator
+BinarySearchTree<Key, Compare, Mapped>::Range::begin() const {
+  return first_;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::ConstIterator
+BinarySearchTree<Key, Compare, Mapped>::Range::end() const {
+  return last_;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+BinarySearchTree<Key, Compare, Mapped>::NodePool::NodePool()
+    : used_in_last_slab_(0),
+      free_list_(nullptr) {}
+
+template<typename Key, typename Compare, typename Mapped>
+BinarySearchTree<Key, Compare, Mapped>::NodePool::~NodePool() {
+  Clear();
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::Node*
+BinarySearchTree<Key, Compare, Mapped>::NodePool::Create(
+    KeyParam value, const MappedStorage& mapped, Node* parent) {
+  if (free_list_ != nullptr) {
+    FreeSlot* slot = free_list_;
+    FreeSlot* next = slot->next;
+    Node* node;
+    try {
+      node = new (slot) Node(value, mapped, parent);
+    } catch (...) {
+      new (slot) FreeSlot{next};
+      throw;
+    }
+    free_list_ = next;
+    return node;
+  }
+  if (slabs_.empty() || used_in_last_slab_ == slabs_.back().capacity) {
+    size_t capacity = slabs_.empty()
+        ? kMinSlabNodes
+        : std::min(slabs_.back().capacity * 2, kMaxSlabNodes);
+    slabs_.reserve(slabs_.size() + 1);
+    Node* nodes = static_cast<Node*>(::operator new(capacity * sizeof(Node)));
+    slabs_.push_back({nodes, capacity});
+    used_in_last_slab_ = 0;
+  }
+  Node* place = slabs_.back().nodes + used_in_last_slab_;
+  Node* node = new (place) Node(value, mapped, parent);
+  ++used_in_last_slab_;
+  return node;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+void BinarySearchTree<Key, Compare, Mapped>::NodePool::Destroy(Node* node) {
+  node->~Node();
+  free_list_ = new (node) FreeSlot{free_list_};
+}
+
+template<typename Key, typename Compare, typename Mapped>
+void BinarySearchTree<Key, Compare, Mapped>::NodePool::Clear() {
+  for (const Slab& slab : slabs_) {
+    ::operator delete(slab.nodes);
+  }
+  slabs_.clear();
+  used_in_last_slab_ = 0;
+  free_list_ = nullptr;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+void BinarySearchTree<Key, Compare, Mapped>::NodePool::Adopt(
+    NodePool* other) {
+  if (slabs_.empty()) {
+    // Последним становится последний блок 'other', и выдача продолжается
+    // с его свободного хвоста.
+    slabs_.swap(other->slabs_);
+    used_in_last_slab_ = other->used_in_last_slab_;
+  } else {
+    // Собственный последний блок остаётся последним: из него продолжают
+    // выдаваться вершины.
+    slabs_.insert(slabs_.begin(), other->slabs_.begin(),
+                  other->slabs_.end());
+  }
+  while (other->free_list_ != nullptr) {
+    FreeSlot* slot = other->free_list_;
+    other->free_list_ = slot->next;
+    slot->next = free_list_;
+    free_list_ = slot;
+  }
+  other->slabs_.clear();
+  other->used_in_last_slab_ = 0;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+BinarySearchTree<Key, Compare, Mapped>::BinarySearchTree(
+    const Compare& compare)
+    : root_(nullptr),
+      size_(0),
+      compare_(compare) {}
+
+template<typename Key, typename Compare, typename Mapped>
+BinarySearchTree<Key, Compare, Mapped>::~BinarySearchTree() {
+  DestroyNodes();
 }
 
-BinarySearchTree::BinarySearchTree() : root_(nullptr), size_(0) {}
+template<typename Key, typename Compare, typename Mapped>
+BinarySearchTree<Key, Compare, Mapped>::BinarySearchTree(
+    BinarySearchTree&& other) noexcept
+    : root_(other.root_),
+      size_(other.size_),
+      pool_(std::move(other.pool_)),
+      compare_(other.compare_) {
+  other.root_ = nullptr;
+  other.size_ = 0;
+}
 
-BinarySearchTree::~BinarySearchTree() {
-  delete root_;
+template<typename Key, typename Compare, typename Mapped>
+BinarySearchTree<Key, Compare, Mapped>&
+BinarySearchTree<Key, Compare, Mapped>::operator=(
+    BinarySearchTree&& other) noexcept {
+  if (this != &other) {
+    DestroyNodes();
+    root_ = other.root_;
+    size_ = other.size_;
+    pool_ = std::move(other.pool_);
+    compare_ = other.compare_;
+    other.root_ = nullptr;
+    other.size_ = 0;
+  }
+  return *this;
 }
 
-size_t BinarySearchTree::Size() const {
+template<typename Key, typename Compare, typename Mapped>
+size_t BinarySearchTree<Key, Compare, Mapped>::Size() const {
   return size_;
 }
 
-bool BinarySearchTree::Contains(int value) const {
+template<typename Key, typename Compare, typename Mapped>
+int BinarySearchTree<Key, Compare, Mapped>::Height() const {
+  return GetHeight(root_);
+}
+
+template<typename Key, typename Compare, typename Mapped>
+bool BinarySearchTree<Key, Compare, Mapped>::Contains(KeyParam value) const {
   return Find(value);
 }
 
-void BinarySearchTree::Add(int value) {
-  ++size_;
+template<typename Key, typename Compare, typename Mapped>
+template<typename K, typename C, typename>
+bool BinarySearchTree<Key, Compare, Mapped>::Contains(const K& value) const {
+  return Find(value);
+}
+
+template<typename Key, typename Compare, typename Mapped>
+void BinarySearchTree<Key, Compare, Mapped>::ContainsBatch(
+    const Key* keys, size_t count, bool* out) const {
+  // Число одновременных спусков: достаточно, чтобы скрыть задержку
+  // памяти, и не больше, чем помещается в регистры и кэш L1.
+  constexpr size_t kLanes = 32;
+  // Незавершённый спуск: текущая вершина и номер ключа.
+  struct Lane {
+    const Node* node;
+    size_t index;
+  };
+  Lane lanes[kLanes];
+  size_t next = 0;
+  size_t active = 0;
+  for (; active < kLanes && next < count; ++active, ++next) {
+    lanes[active] = {root_, next};
+  }
+  while (active > 0) {
+    for (size_t i = 0; i < active;) {
+      Lane& lane = lanes[i];
+      const Node* node = lane.node;
+      const Key& value = keys[lane.index];
+      bool finished = true;
+      if (node == nullptr) {
+        out[lane.index] = false;
+      } else if (compare_(value, node->value)) {
+        lane.node = node->left;
+        finished = false;
+      } else if (compare_(node->value, value)) {
+        lane.node = node->right;
+        finished = false;
+      } else {
+        out[lane.index] = true;
+      }
+      if (!finished) {
+        PrefetchNode(lane.node);
+        ++i;
+      } else if (next < count) {
+        lane = {root_, next++};
+        ++i;
+      } else {
+        lane = lanes[--active];
+      }
+    }
+  }
+}
+
+template<typename Key, typename Compare, typename Mapped>
+void BinarySearchTree<Key, Compare, Mapped>::Add(KeyParam value) {
+  Insert(value, MappedStorage());
+}
+
+template<typename Key, typename Compare, typename Mapped>
+template<typename M, typename>
+void BinarySearchTree<Key, Compare, Mapped>::Add(KeyParam value,
+                                                 const M& mapped) {
+  Insert(value, mapped);
+}
+
+template<typename Key, typename Compare, typename Mapped>
+template<typename M>
+std::enable_if_t<!std::is_void_v<M>, M*>
+BinarySearchTree<Key, Compare, Mapped>::Get(KeyParam value) {
+  Node* node = Find(value);
+  return node == nullptr ? nullptr : &node->mapped;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+template<typename M>
+std::enable_if_t<!std::is_void_v<M>, const M*>
+BinarySearchTree<Key, Compare, Mapped>::Get(KeyParam value) const {
+  const Node* node = Find(value);
+  return node == nullptr ? nullptr : &node->mapped;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+void BinarySearchTree<Key, Compare, Mapped>::Insert(
+    KeyParam value, const MappedStorage& mapped) {
   if (root_ == nullptr) {
-    root_ = new Node(value, nullptr);
+    root_ = GetPool().Create(value, mapped, nullptr);
+    ++size_;
     return;
   }
   Node* node = root_;
   while (true) {
-    if (node->value > value) {
+    if (compare_(value, node->value)) {
       if (node->left != nullptr) {
         node = node->left;
       } else {
-        node->left = new Node(value, node);
-        return;
+        node->left = pool_->Create(value, mapped, node);
+        break;
       }
     } else {
       if (node->right != nullptr) {
         node = node->right;
       } else {
-        node->right = new Node(value, node);
-        return;
+        node->right = pool_->Create(value, mapped, node);
+        break;
       }
     }
   }
+  ++size_;
+  Rebalance(node);
 }
 
-void BinarySearchTree::Erase(int value) {
+template<typename Key, typename Compare, typename Mapped>
+void BinarySearchTree<Key, Compare, Mapped>::Erase(KeyParam value) {
   Node* node = Find(value);
   if (node == nullptr) return;
   --size_;
+  // Самая нижняя вершина, высота которой могла измениться.
+  Node* changed_node = node->parent;
   if (node->left == nullptr) {
     ReplacePointers(node, node->right);
   } else if (node->right == nullptr) {
     ReplacePointers(node, node->left);
   } else {
     Node* leftmost_node = GetLeftmostNode(node->right);
+    changed_node = leftmost_node;
     if (leftmost_node->parent != node) {
+      changed_node = leftmost_node->parent;
       ReplacePointers(leftmost_node, leftmost_node->right);
       leftmost_node->right = node->right;
       leftmost_node->right->parent = leftmost_node;
@@ -140,44 +791,235 @@ void BinarySearchTree::Erase(int value) {
     leftmost_node->left = node->left;
     leftmost_node->left->parent = leftmost_node;
   }
-  node->left = nullptr;
-  node->right = nullptr;
-  delete node;
+  Rebalance(changed_node);
+  pool_->Destroy(node);
 }
 
-std::vector<int> BinarySearchTree::ToSortedArray() const {
-  std::vector<int> res;
-  AppendToSortedArray(root_, &res);
+template<typename Key, typename Compare, typename Mapped>
+std::vector<Key> BinarySearchTree<Key, Compare, Mapped>::ToSortedArray() const {
+  std::vector<Key> res;
+  res.reserve(size_);
+  for (const Key& value : *this) {
+    res.push_back(value);
+  }
   return res;
 }
 
-BinarySearchTree::Node* BinarySearchTree::Find(int value) const {
-  Node* node = root_;
-  while (node != nullptr && node->value != value) {
-    if (node->value > value) {
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::ConstIterator
+BinarySearchTree<Key, Compare, Mapped>::begin() const {
+  return ConstIterator(root_ == nullptr ? nullptr : GetLeftmostNode(root_),
+                       this);
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::ConstIterator
+BinarySearchTree<Key, Compare, Mapped>::end() const {
+  return ConstIterator(nullptr, this);
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::ConstIterator
+BinarySearchTree<Key, Compare, Mapped>::LowerBound(KeyParam value) const {
+  return ConstIterator(LowerBoundNode(value, false), this);
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::ConstIterator
+BinarySearchTree<Key, Compare, Mapped>::UpperBound(KeyParam value) const {
+  return ConstIterator(LowerBoundNode(value, true), this);
+}
+
+template<typename Key, typename Compare, typename Mapped>
+size_t BinarySearchTree<Key, Compare, Mapped>::Rank(KeyParam value) const {
+  return CountLess(value, false);
+}
+
+template<typename Key, typename Compare, typename Mapped>
+const Key& BinarySearchTree<Key, Compare, Mapped>::KthSmallest(
+    size_t k) const {
+  assert(k < size_);
+  const Node* node = root_;
+  while (true) {
+    size_t left_size = GetSize(node->left);
+    if (k < left_size) {
       node = node->left;
+    } else if (k == left_size) {
+      return node->value;
     } else {
+      k -= left_size + 1;
       node = node->right;
     }
   }
-  return node;
 }
 
-BinarySearchTree::Node* BinarySearchTree::GetLeftmostNode(Node* node) const {
+template<typename Key, typename Compare, typename Mapped>
+size_t BinarySearchTree<Key, Compare, Mapped>::CountInRange(
+    KeyParam lo, KeyParam hi) const {
+  if (compare_(hi, lo)) {
+    return 0;
+  }
+  return CountLess(hi, true) - CountLess(lo, false);
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::Range
+BinarySearchTree<Key, Compare, Mapped>::GetRange(KeyParam lo,
+                                                 KeyParam hi) const {
+  if (compare_(hi, lo)) {
+    return Range(end(), end());
+  }
+  return Range(LowerBound(lo), UpperBound(hi));
+}
+
+template<typename Key, typename Compare, typename Mapped>
+void BinarySearchTree<Key, Compare, Mapped>::Clear() {
+  DestroyNodes();
+  if (pool_.use_count() == 1) {
+    pool_->Clear();
+  }
+  size_ = 0;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+template<typename It>
+void BinarySearchTree<Key, Compare, Mapped>::BuildFromSorted(It first,
+                                                             It last) {
+  assert(std::is_sorted(first, last, compare_));
+  Clear();
+  size_t count = std::distance(first, last);
+  NodePool& pool = GetPool();
+  auto next_node = [&pool, &first] {
+    Node* node = pool.Create(*first, MappedStorage(), nullptr);
+    ++first;
+    return node;
+  };
+  root_ = BuildBalanced(count, next_node);
+  size_ = count;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+void BinarySearchTree<Key, Compare, Mapped>::Merge(BinarySearchTree& other) {
+  if (this == &other || other.root_ == nullptr) {
+    return;
+  }
+  Node* other_root = other.root_;
+  if (other.pool_ != pool_) {
+    if (other.pool_.use_count() == 1) {
+      GetPool().Adopt(other.pool_.get());
+    } else {
+      // Пул 'other' нужен ещё какому-то дереву: копируем вершины.
+      NodePool& pool = GetPool();
+      const Node* source = GetLeftmostNode(other.root_);
+      auto next_node = [&pool, &source] {
+        Node* node = pool.Create(source->value, source->mapped, nullptr);
+        source = GetNextNode(source);
+        return node;
+      };
+      other_root = BuildBalanced(other.size_, next_node);
+      other.Clear();
+    }
+  }
+  size_t other_size = GetSize(other_root);
+  if (root_ != nullptr
+      && !compare_(GetLeftmostNode(other_root)->value,
+                   GetRightmostNode(root_)->value)) {
+    // Ключи 'other' не меньше ключей дерева: достаточно одного Join.
+    Node* middle;
+    Node* right = RemoveLeftmost(Detach(other_root), &middle);
+    root_ = Join(Detach(root_), middle, right);
+  } else if (root_ != nullptr
+             && !compare_(GetLeftmostNode(root_)->value,
+                          GetRightmostNode(other_root)->value)) {
+    Node* middle;
+    Node* right = RemoveLeftmost(Detach(root_), &middle);
+    root_ = Join(Detach(other_root), middle, right);
+  } else {
+    root_ = Unite(root_, other_root);
+  }
+  size_ += other_size;
+  other.root_ = nullptr;
+  other.size_ = 0;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+BinarySearchTree<Key, Compare, Mapped>
+BinarySearchTree<Key, Compare, Mapped>::Split(KeyParam value) {
+  BinarySearchTree result(compare_);
+  result.pool_ = pool_;
+  SplitSubtree(root_, value, &root_, &result.root_);
+  size_ = GetSize(root_);
+  result.size_ = GetSize(result.root_);
+  return result;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::NodePool&
+BinarySearchTree<Key, Compare, Mapped>::GetPool() {
+  if (pool_ == nullptr) {
+    pool_ = std::make_shared<NodePool>();
+  }
+  return *pool_;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+template<typename K>
+typename BinarySearchTree<Key, Compare, Mapped>::Node*
+BinarySearchTree<Key, Compare, Mapped>::Find(const K& value) const {
+  if constexpr (std::is_scalar_v<Key> && std::is_scalar_v<K>) {
+    // Сравнение чисел дёшево: выходим, как только нашли равный ключ.
+    Node* node = root_;
+    while (node != nullptr) {
+      if (compare_(value, node->value)) {
+        node = node->left;
+      } else if (compare_(node->value, value)) {
+        node = node->right;
+      } else {
+        break;
+      }
+    }
+    return node;
+  } else {
+    // Дорогие сравнения (например, строк): одно сравнение на уровень
+    // при спуске и одна проверка на равенство в конце.
+    Node* candidate = nullptr;
+    Node* node = root_;
+    while (node != nullptr) {
+      if (compare_(node->value, value)) {
+        node = node->right;
+      } else {
+        candidate = node;
+        node = node->left;
+      }
+    }
+    if (candidate != nullptr && compare_(value, candidate->value)) {
+      candidate = nullptr;
+    }
+    return candidate;
+  }
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::Node*
+BinarySearchTree<Key, Compare, Mapped>::GetLeftmostNode(Node* node) const {
   while (node->left != nullptr) {
     node = node->left;
   }
   return node;
 }
 
-BinarySearchTree::Node* BinarySearchTree::GetRightmostNode(Node* node) const {
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::Node*
+BinarySearchTree<Key, Compare, Mapped>::GetRightmostNode(Node* node) const {
   while (node->right != nullptr) {
     node = node->right;
   }
   return node;
 }
 
-void BinarySearchTree::ReplacePointers(Node* first_node, Node* second_node) {
+template<typename Key, typename Compare, typename Mapped>
+void BinarySearchTree<Key, Compare, Mapped>::ReplacePointers(
+    Node* first_node, Node* second_node) {
   if (first_node->parent == nullptr) {
     root_ = second_node;
   } else if (first_node->parent->left == first_node) {
@@ -190,59 +1032,1719 @@ void BinarySearchTree::ReplacePointers(Node* first_node, Node* second_node) {
   }
 }
 
-void BinarySearchTree::AppendToSortedArray(Node* node,
-                                           std::vector<int>* res) const {
-  if (node == nullptr) return;
-  AppendToSortedArray(node->left, res);
-  res->push_back(node->value);
-  AppendToSortedArray(node->right, res);
+template<typename Key, typename Compare, typename Mapped>
+int BinarySearchTree<Key, Compare, Mapped>::GetHeight(const Node* node) {
+  return node == nullptr ? 0 : node->height;
 }
 
-#ifndef IGNORE_MAIN
-int main() {
-  const int kQueriesCount = 50'000;
-  const std::vector<int>
-      kElementsMaxValues({1, 2, 5, 13, 42, 1024, 1'000'000'000});
+template<typename Key, typename Compare, typename Mapped>
+size_t BinarySearchTree<Key, Compare, Mapped>::GetSize(const Node* node) {
+  return node == nullptr ? 0 : node->size;
+}
 
-  std::mt19937_64 random_generator(2018);
-  for (const int max_element_value : kElementsMaxValues) {
-    std::vector<int> elements;
-    BinarySearchTree tree;
-    for (int i = 0; i < kQueriesCount; ++i) {
-      int query_type = static_cast<int>(random_generator() % 3);
-      switch (query_type) {
-        case 0: {
-          int value;
-          if (elements.empty() || random_generator() % 100 < 75) {
-            value = static_cast<int>(random_generator() % max_element_value);
-            value -= max_element_value / 2;
-          } else {
-            value = elements[random_generator() % elements.size()];
-          }
+template<typename Key, typename Compare, typename Mapped>
+void BinarySearchTree<Key, Compare, Mapped>::UpdateNode(Node* node) {
+  node->height = std::max(GetHeight(node->left), GetHeight(node->right)) + 1;
+  node->size = GetSize(node->left) + GetSize(node->right) + 1;
+}
 
-          elements.push_back(value);
-          sort(elements.begin(), elements.end());  // Never do like this :)
-          tree.Add(value);
-          break;
-        }
-        case 1: {
-          int value;
-          if (elements.empty() || random_generator() % 100 < 40) {
-            value = static_cast<int>(random_generator() % max_element_value);
-            value -= max_element_value / 2;
-          } else {
-            value = elements[random_generator() % elements.size()];
-          }
+template<typename Key, typename Compare, typename Mapped>
+const typename BinarySearchTree<Key, Compare, Mapped>::Node*
+BinarySearchTree<Key, Compare, Mapped>::LowerBoundNode(KeyParam value,
+                                                       bool strict) const {
+  const Node* result = nullptr;
+  const Node* node = root_;
+  while (node != nullptr) {
+    if (strict ? compare_(value, node->value)
+               : !compare_(node->value, value)) {
+      result = node;
+      node = node->left;
+    } else {
+      node = node->right;
+    }
+  }
+  return result;
+}
 
-          bool result = tree.Contains(value);
-          bool expected_result =
-              std::find(elements.begin(), elements.end(), value)
-                  != elements.end();
-          assert(result == expected_result);
-          break;
-        }
-        case 2: {
-          int value;
+template<typename Key, typename Compare, typename Mapped>
+size_t BinarySearchTree<Key, Compare, Mapped>::CountLess(
+    KeyParam value, bool inclusive) const {
+  size_t count = 0;
+  const Node* node = root_;
+  while (node != nullptr) {
+    if (inclusive ? !compare_(value, node->value)
+                  : compare_(node->value, value)) {
+      count += GetSize(node->left) + 1;
+      node = node->right;
+    } else {
+      node = node->left;
+    }
+  }
+  return count;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+const typename BinarySearchTree<Key, Compare, Mapped>::Node*
+BinarySearchTree<Key, Compare, Mapped>::GetNextNode(const Node* node) {
+  if (node->right != nullptr) {
+    node = node->right;
+    while (node->left != nullptr) {
+      node = node->left;
+    }
+    return node;
+  }
+  while (node->parent != nullptr && node->parent->right == node) {
+    node = node->parent;
+  }
+  return node->parent;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+void BinarySearchTree<Key, Compare, Mapped>::PrefetchNode(const Node* node) {
+#ifdef __GNUC__
+  __builtin_prefetch(node);
+#else
+  static_cast<void>(node);
+#endif  // __GNUC__
+}
+
+template<typename Key, typename Compare, typename Mapped>
+const typename BinarySearchTree<Key, Compare, Mapped>::Node*
+BinarySearchTree<Key, Compare, Mapped>::GetPreviousNode(const Node* node) {
+  if (node->left != nullptr) {
+    node = node->left;
+    while (node->right != nullptr) {
+      node = node->right;
+    }
+    return node;
+  }
+  while (node->parent != nullptr && node->parent->left == node) {
+    node = node->parent;
+  }
+  return node->parent;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::Node*
+BinarySearchTree<Key, Compare, Mapped>::RotateLeft(Node* node) {
+  Node* pivot = node->right;
+  ReplacePointers(node, pivot);
+  node->right = pivot->left;
+  if (node->right != nullptr) {
+    node->right->parent = node;
+  }
+  pivot->left = node;
+  node->parent = pivot;
+  UpdateNode(node);
+  UpdateNode(pivot);
+  return pivot;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::Node*
+BinarySearchTree<Key, Compare, Mapped>::RotateRight(Node* node) {
+  Node* pivot = node->left;
+  ReplacePointers(node, pivot);
+  node->left = pivot->right;
+  if (node->left != nullptr) {
+    node->left->parent = node;
+  }
+  pivot->right = node;
+  node->parent = pivot;
+  UpdateNode(node);
+  UpdateNode(pivot);
+  return pivot;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+void BinarySearchTree<Key, Compare, Mapped>::Rebalance(Node* node) {
+  while (node != nullptr) {
+    int balance = GetHeight(node->right) - GetHeight(node->left);
+    if (balance > 1) {
+      if (GetHeight(node->right->left) > GetHeight(node->right->right)) {
+        RotateRight(node->right);
+      }
+      node = RotateLeft(node);
+    } else if (balance < -1) {
+      if (GetHeight(node->left->right) > GetHeight(node->left->left)) {
+        RotateLeft(node->left);
+      }
+      node = RotateRight(node);
+    } else {
+      UpdateNode(node);
+    }
+    node = node->parent;
+  }
+}
+
+template<typename Key, typename Compare, typename Mapped>
+void BinarySearchTree<Key, Compare, Mapped>::DestroyNodes() {
+  bool shared_pool = pool_.use_count() > 1;
+  if (shared_pool || !std::is_trivially_destructible_v<Node>) {
+    // Пока у вершины есть левый ребёнок, поворачиваем направо; вершина
+    // без левого ребёнка разрушается, и обход продолжается с правого.
+    Node* node = root_;
+    while (node != nullptr) {
+      if (node->left != nullptr) {
+        Node* left = node->left;
+        node->left = left->right;
+        left->right = node;
+        node = left;
+      } else {
+        Node* right = node->right;
+        if (shared_pool) {
+          pool_->Destroy(node);
+        } else {
+          node->~Node();
+        }
+        node = right;
+      }
+    }
+  }
+  root_ = nullptr;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+template<typename NextNode>
+typename BinarySearchTree<Key, Compare, Mapped>::Node*
+BinarySearchTree<Key, Compare, Mapped>::BuildBalanced(size_t count,
+                                                      NextNode& next_node) {
+  if (count == 0) {
+    return nullptr;
+  }
+  size_t left_count = (count - 1) / 2;
+  Node* left = BuildBalanced(left_count, next_node);
+  Node* node = next_node();
+  Node* right = BuildBalanced(count - 1 - left_count, next_node);
+  node->left = left;
+  node->right = right;
+  if (left != nullptr) {
+    left->parent = node;
+  }
+  if (right != nullptr) {
+    right->parent = node;
+  }
+  UpdateNode(node);
+  return node;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::Node*
+BinarySearchTree<Key, Compare, Mapped>::Detach(Node* node) {
+  if (node != nullptr) {
+    node->parent = nullptr;
+  }
+  return node;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::Node*
+BinarySearchTree<Key, Compare, Mapped>::Join(Node* left, Node* middle,
+                                             Node* right) {
+  bool left_is_higher = GetHeight(left) > GetHeight(right) + 1;
+  bool right_is_higher = GetHeight(right) > GetHeight(left) + 1;
+  // Спускаемся по правому краю более высокого левого дерева (или по левому
+  // краю правого) до поддерева, высота которого почти равна высоте
+  // другого дерева, и подвешиваем на его место вершину 'middle'.
+  Node* parent = nullptr;
+  if (left_is_higher) {
+    while (GetHeight(left) > GetHeight(right) + 1) {
+      parent = left;
+      left = left->right;
+    }
+  } else if (right_is_higher) {
+    while (GetHeight(right) > GetHeight(left) + 1) {
+      parent = right;
+      right = right->left;
+    }
+  }
+  middle->left = left;
+  middle->right = right;
+  middle->parent = parent;
+  if (left != nullptr) {
+    left->parent = middle;
+  }
+  if (right != nullptr) {
+    right->parent = middle;
+  }
+  UpdateNode(middle);
+  if (parent == nullptr) {
+    return middle;
+  }
+  (left_is_higher ? parent->right : parent->left) = middle;
+
+  // Rebalance поднимается до корня, а повороты в корне обновляют root_;
+  // на время восстановления баланса корнем считается корень высокого
+  // дерева.
+  Node* tree_root = parent;
+  while (tree_root->parent != nullptr) {
+    tree_root = tree_root->parent;
+  }
+  Node* saved_root = root_;
+  root_ = tree_root;
+  Rebalance(parent);
+  Node* result = root_;
+  root_ = saved_root;
+  return result;
+}
+
+template<typename Key, typename Compare, typename Mapped>
+void BinarySearchTree<Key, Compare, Mapped>::SplitSubtree(Node* node,
+                                                          KeyParam value,
+                                                          Node** left,
+                                                          Node** right) {
+  if (node == nullptr) {
+    *left = nullptr;
+    *right = nullptr;
+    return;
+  }
+  Node* node_left = Detach(node->left);
+  Node* node_right = Detach(node->right);
+  if (compare_(node->value, value)) {
+    Node* right_left;
+    SplitSubtree(node_right, value, &right_left, right);
+    *left = Join(node_left, node, right_left);
+  } else {
+    Node* left_right;
+    SplitSubtree(node_left, value, left, &left_right);
+    *right = Join(left_right, node, node_right);
+  }
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::Node*
+BinarySearchTree<Key, Compare, Mapped>::Unite(Node* first, Node* second) {
+  if (first == nullptr) {
+    return Detach(second);
+  }
+  if (second == nullptr) {
+    return Detach(first);
+  }
+  Detach(first);
+  Detach(second);
+  Node* second_left = Detach(second->left);
+  Node* second_right = Detach(second->right);
+  Node* first_left;
+  Node* first_right;
+  SplitSubtree(first, second->value, &first_left, &first_right);
+  Node* left = Unite(first_left, second_left);
+  Node* right = Unite(first_right, second_right);
+  return Join(left, second, right);
+}
+
+template<typename Key, typename Compare, typename Mapped>
+typename BinarySearchTree<Key, Compare, Mapped>::Node*
+BinarySearchTree<Key, Compare, Mapped>::RemoveLeftmost(Node* node,
+                                                       Node** leftmost) {
+  Node* node_left = Detach(node->left);
+  Node* node_right = Detach(node->right);
+  if (node_left == nullptr) {
+    *leftmost = node;
+    return node_right;
+  }
+  Node* rest = RemoveLeftmost(node_left, leftmost);
+  return Join(rest, node, node_right);
+}
+
+// Неизменяемое дерево поиска для множеств, которые читают много чаще,
+// чем изменяют. Ключи лежат в B-дереве без указателей (S-дереве): блок
+// из kBlockKeys = 16 ключей занимает ровно одну кэш-линию, а дети блока
+// с номером k имеют номера k * (kBlockKeys + 1) + i + 1. Поиск делает
+// один промах кэша на уровень, а уровней в log2(17) раз меньше, чем у
+// бинарного дерева; позиция внутри блока находится сравнением сразу всех
+// ключей блока (SSE2).
+// Строится из отсортированного массива, например из
+// BinarySearchTree::ToSortedArray(), и после этого не изменяется.
+class StaticSearchTree {
+ public:
+  // Пустое дерево.
+  StaticSearchTree();
+
+  // Строит дерево из массива, упорядоченного по неубыванию.
+  explicit StaticSearchTree(const std::vector<int>& sorted);
+
+  // Строит дерево из элементов 'tree'.
+  explicit StaticSearchTree(const BinarySearchTree<int>& tree);
+
+  // Возвращает количество элементов в дереве.
+  size_t Size() const;
+
+  // Метод возвращает "true" если элемент со значением 'value' имеется в дереве
+  // поиска и "false" в противном случае.
+  bool Contains(int value) const;
+
+  // Возвращает массив из элементов, содержащихся в дереве поиска,
+  // расположенными в порядке неубывания.
+  std::vector<int> ToSortedArray() const;
+
+ protected:
+  static constexpr int kBlockKeys = 16;
+
+  // Значение, которым дополняются незаполненные позиции блоков.
+  static constexpr int kPadding = std::numeric_limits<int>::max();
+
+  struct alignas(64) Block {
+    int keys[kBlockKeys];
+  };
+
+  std::vector<Block> blocks_;
+  size_t size_;
+
+  // Содержит ли дерево настоящий ключ, равный kPadding.
+  bool contains_padding_value_;
+
+  // Номер i-го ребёнка блока 'block'.
+  static size_t GetChild(size_t block, int i);
+
+  // Количество ключей блока, меньших 'value'.
+  static int CountLess(const Block& block, int value);
+
+  // Раскладывает элементы sorted[*position..] по блокам поддерева с корнем
+  // в блоке 'block' в порядке обхода.
+  void Build(size_t block, const std::vector<int>& sorted, size_t* position);
+
+  // Дописывает элементы поддерева с корнем в блоке 'block' в конец *res,
+  // пока в нём меньше size_ элементов.
+  void AppendToSortedArray(size_t block, std::vector<int>* res) const;
+};
+
+StaticSearchTree::StaticSearchTree()
+    : size_(0),
+      contains_padding_value_(false) {}
+
+StaticSearchTree::StaticSearchTree(const std::vector<int>& sorted)
+    : blocks_((sorted.size() + kBlockKeys - 1) / kBlockKeys),
+      size_(sorted.size()),
+      contains_padding_value_(!sorted.empty() && sorted.back() == kPadding) {
+  assert(std::is_sorted(sorted.begin(), sorted.end()));
+  size_t position = 0;
+  Build(0, sorted, &position);
+}
+
+StaticSearchTree::StaticSearchTree(const BinarySearchTree<int>& tree)
+    : StaticSearchTree(tree.ToSortedArray()) {}
+
+size_t StaticSearchTree::Size() const {
+  return size_;
+}
+
+bool StaticSearchTree::Contains(int value) const {
+  if (value == kPadding) {
+    return contains_padding_value_;
+  }
+  size_t block = 0;
+  while (block < blocks_.size()) {
+    int position = CountLess(blocks_[block], value);
+    if (position < kBlockKeys && blocks_[block].keys[position] == value) {
+      return true;
+    }
+    block = GetChild(block, position);
+  }
+  return false;
+}
+
+std::vector<int> StaticSearchTree::ToSortedArray() const {
+  std::vector<int> res;
+  res.reserve(size_);
+  AppendToSortedArray(0, &res);
+  return res;
+}
+
+size_t StaticSearchTree::GetChild(size_t block, int i) {
+  return block * (kBlockKeys + 1) + i + 1;
+}
+
+int StaticSearchTree::CountLess(const Block& block, int value) {
+#ifdef SEARCH_TREE_SIMD_X86
+  // Ключи блока упорядочены, поэтому маска "ключ < value" имеет вид
+  // 0...01...1, и число её единиц равно числу младших единиц.
+  const __m128i* keys = reinterpret_cast<const __m128i*>(block.keys);
+  __m128i needle = _mm_set1_epi32(value);
+  __m128i less_low = _mm_packs_epi32(
+      _mm_cmpgt_epi32(needle, _mm_load_si128(keys)),
+      _mm_cmpgt_epi32(needle, _mm_load_si128(keys + 1)));
+  __m128i less_high = _mm_packs_epi32(
+      _mm_cmpgt_epi32(needle, _mm_load_si128(keys + 2)),
+      _mm_cmpgt_epi32(needle, _mm_load_si128(keys + 3)));
+  unsigned mask = static_cast<unsigned>(
+      _mm_movemask_epi8(_mm_packs_epi16(less_low, less_high)));
+  return __builtin_ctz(~mask);
+#else
+  int count = 0;
+  for (int i = 0; i < kBlockKeys; ++i) {
+    count += block.keys[i] < value;
+  }
+  return count;
+#endif  // SEARCH_TREE_SIMD_X86
+}
+
+void StaticSearchTree::Build(size_t block, const std::vector<int>& sorted,
+                             size_t* position) {
+  if (block >= blocks_.size()) return;
+  for (int i = 0; i < kBlockKeys; ++i) {
+    Build(GetChild(block, i), sorted, position);
+    blocks_[block].keys[i] =
+        *position < sorted.size() ? sorted[(*position)++] : kPadding;
+  }
+  Build(GetChild(block, kBlockKeys), sorted, position);
+}
+
+void StaticSearchTree::AppendToSortedArray(size_t block,
+                                           std::vector<int>* res) const {
+  if (block >= blocks_.size()) return;
+  for (int i = 0; i < kBlockKeys && res->size() < size_; ++i) {
+    AppendToSortedArray(GetChild(block, i), res);
+    if (res->size() < size_) {
+      res->push_back(blocks_[block].keys[i]);
+    }
+  }
+  AppendToSortedArray(GetChild(block, kBlockKeys), res);
+}
+
+// Двоичный формат отсортированного множества целых ключей.
+//
+//   заголовок    SortedKeysHeader
+//   индекс       по записи SortedKeysIndexEntry на блок
+//   данные       для каждого блока - разности соседних ключей блока,
+//                кроме первого, в виде varint (LEB128)
+//
+// Ключи разбиты на блоки по kSortedKeysBlockSize. Первый ключ блока и
+// смещение его данных хранятся в разреженном индексе, поэтому поиск
+// делает двоичный поиск по индексу и декодирует не более одного блока.
+// Все числа записываются в порядке байтов машины (little-endian на x86).
+
+constexpr char kSortedKeysMagic[8] = {'B', 'S', 'T', 'K', 'E', 'Y', 'S', '1'};
+constexpr uint32_t kSortedKeysBlockSize = 128;
+
+struct SortedKeysHeader {
+  char magic[8];
+  uint64_t count;
+  uint64_t blocks;
+  uint32_t block_size;
+  uint32_t reserved;
+  uint64_t data_size;
+};
+
+struct SortedKeysIndexEntry {
+  int64_t first_key;
+  uint64_t offset;
+};
+
+// Дописывает 'value' в конец 'out' в формате LEB128.
+inline void AppendVarint(uint64_t value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+// Читает число в формате LEB128, начинающееся в *data и заканчивающееся
+// не позже 'end', и сдвигает *data. Бросает std::runtime_error, если число
+// обрывается на 'end' или не помещается в uint64_t (длиннее 10 байт).
+inline uint64_t ReadVarint(const unsigned char** data,
+                           const unsigned char* end) {
+  uint64_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    if (*data == end || (shift == 63 && **data > 1)) {
+      throw std::runtime_error("Corrupt varint in sorted keys");
+    }
+    unsigned char byte = *(*data)++;
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+}
+
+// Читает разность, начинающуюся в *data, и возвращает следующий за
+// 'previous' ключ блока. Сложение по модулю 2^64 корректно для любых
+// int64_t, в том числе когда разность не помещается в int64_t.
+inline int64_t ReadNextKey(int64_t previous, const unsigned char** data,
+                           const unsigned char* end) {
+  return static_cast<int64_t>(static_cast<uint64_t>(previous)
+                              + ReadVarint(data, end));
+}
+
+// Записывает 'count' ключей из [first, first + count), упорядоченных по
+// неубыванию, в поток 'out'. Бросает std::runtime_error при ошибке записи.
+template<typename It>
+void WriteSortedKeys(It first, size_t count, std::ostream& out) {
+  SortedKeysHeader header = {};
+  std::copy(std::begin(kSortedKeysMagic), std::end(kSortedKeysMagic),
+            header.magic);
+  header.count = count;
+  header.blocks = (count + kSortedKeysBlockSize - 1) / kSortedKeysBlockSize;
+  header.block_size = kSortedKeysBlockSize;
+
+  std::vector<SortedKeysIndexEntry> index;
+  index.reserve(header.blocks);
+  std::string data;
+  int64_t previous = 0;
+  for (size_t i = 0; i < count; ++i, ++first) {
+    int64_t key = *first;
+    if (i % kSortedKeysBlockSize == 0) {
+      index.push_back({key, data.size()});
+    } else {
+      assert(previous <= key);
+      AppendVarint(static_cast<uint64_t>(key) - static_cast<uint64_t>(previous),
+                   &data);
+    }
+    previous = key;
+  }
+  header.data_size = data.size();
+
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(index.data()),
+            index.size() * sizeof(SortedKeysIndexEntry));
+  out.write(data.data(), data.size());
+  if (!out) {
+    throw std::runtime_error("Failed to write sorted keys");
+  }
+}
+
+template<typename Key, typename Compare, typename Mapped>
+void BinarySearchTree<Key, Compare, Mapped>::Serialize(std::ostream& out)
+    const {
+  static_assert(std::is_integral_v<Key>
+                    && (sizeof(Key) < sizeof(int64_t) || std::is_signed_v<Key>),
+                "Serialize requires keys representable as int64_t");
+  WriteSortedKeys(begin(), size_, out);
+}
+
+// Множество ключей, записанное WriteSortedKeys, отображённое в память
+// только для чтения. Открытие стоит одного вызова mmap: ключи не
+// декодируются заранее, а страницы файла подгружаются по мере обращения.
+// Contains и Rank работают за O(log(n / B) + B), где B - размер блока.
+class MappedSortedKeys {
+ public:
+  // Отображает файл 'path' в память. Бросает std::runtime_error, если
+  // файл не открывается или не является файлом нужного формата.
+  // Заголовок и индекс проверяются целиком за O(n / B); разности внутри
+  // блока проверяются при декодировании, и методы ниже бросают
+  // std::runtime_error, встретив повреждённый блок.
+  explicit MappedSortedKeys(const std::string& path);
+  ~MappedSortedKeys();
+
+  MappedSortedKeys(const MappedSortedKeys&) = delete;
+  MappedSortedKeys& operator=(const MappedSortedKeys&) = delete;
+
+  // Возвращает количество ключей.
+  size_t Size() const;
+
+  // Проверяет, есть ли ключ 'value' в множестве.
+  bool Contains(int64_t value) const;
+
+  // Возвращает количество ключей, строго меньших 'value'.
+  size_t Rank(int64_t value) const;
+
+  // Декодирует все ключи в порядке неубывания.
+  std::vector<int64_t> ToSortedArray() const;
+
+ protected:
+  void* mapping_;
+  size_t mapping_size_;
+  SortedKeysHeader header_;
+  const SortedKeysIndexEntry* index_;
+  const unsigned char* data_;
+
+  // Номер блока, в котором должен находиться 'value' (или первого блока,
+  // если 'value' меньше всех ключей).
+  size_t FindBlock(int64_t value) const;
+
+  // Количество ключей блока 'block', строго меньших 'value'.
+  size_t CountLessInBlock(size_t block, int64_t value) const;
+
+  size_t GetBlockSize(size_t block) const;
+  int64_t GetFirstKey(size_t block) const;
+  uint64_t GetOffset(size_t block) const;
+
+  // Начало и конец разностей блока 'block'.
+  const unsigned char* GetBlockData(size_t block) const;
+  const unsigned char* GetBlockDataEnd(size_t block) const;
+
+  // Проверяет согласованность заголовка и индекса с размером файла.
+  bool IsValid() const;
+};
+
+MappedSortedKeys::MappedSortedKeys(const std::string& path)
+    : mapping_(nullptr),
+      mapping_size_(0) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open " + path);
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0
+      || static_cast<size_t>(file_stat.st_size) < sizeof(SortedKeysHeader)) {
+    close(fd);
+    throw std::runtime_error("Not a sorted keys file: " + path);
+  }
+  mapping_size_ = file_stat.st_size;
+  mapping_ = mmap(nullptr, mapping_size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping_ == MAP_FAILED) {
+    throw std::runtime_error("Failed to map " + path);
+  }
+
+  const unsigned char* bytes = static_cast<const unsigned char*>(mapping_);
+  std::memcpy(&header_, bytes, sizeof(header_));
+  index_ = reinterpret_cast<const SortedKeysIndexEntry*>(
+      bytes + sizeof(header_));
+  if (!IsValid()) {
+    munmap(mapping_, mapping_size_);
+    throw std::runtime_error("Not a sorted keys file: " + path);
+  }
+  data_ = bytes + sizeof(header_)
+      + header_.blocks * sizeof(SortedKeysIndexEntry);
+}
+
+bool MappedSortedKeys::IsValid() const {
+  if (!std::equal(std::begin(kSortedKeysMagic), std::end(kSortedKeysMagic),
+                  header_.magic)
+      || header_.block_size != kSortedKeysBlockSize
+      || header_.count > std::numeric_limits<uint64_t>::max()
+                             - (kSortedKeysBlockSize - 1)
+      || header_.blocks != (header_.count + kSortedKeysBlockSize - 1)
+                               / kSortedKeysBlockSize) {
+    return false;
+  }
+  // Все размеры сравниваются без переполнения: индекс и данные должны
+  // занимать ровно остаток файла после заголовка.
+  size_t available = mapping_size_ - sizeof(header_);
+  if (header_.blocks > available / sizeof(SortedKeysIndexEntry)) {
+    return false;
+  }
+  available -= header_.blocks * sizeof(SortedKeysIndexEntry);
+  if (header_.data_size != available) {
+    return false;
+  }
+  // Блок из k ключей хранит k - 1 разностей не короче байта каждая, и
+  // последний байт блока завершает varint. Первые ключи не убывают.
+  const unsigned char* data = reinterpret_cast<const unsigned char*>(
+      index_ + header_.blocks);
+  for (size_t block = 0; block < header_.blocks; ++block) {
+    uint64_t begin = GetOffset(block);
+    uint64_t end = block + 1 < header_.blocks ? GetOffset(block + 1)
+                                              : header_.data_size;
+    if (begin > end || end > header_.data_size
+        || end - begin < GetBlockSize(block) - 1) {
+      return false;
+    }
+    if (end > begin && (data[end - 1] & 0x80) != 0) {
+      return false;
+    }
+    if (block > 0 && GetFirstKey(block - 1) > GetFirstKey(block)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+MappedSortedKeys::~MappedSortedKeys() {
+  munmap(mapping_, mapping_size_);
+}
+
+size_t MappedSortedKeys::Size() const {
+  return header_.count;
+}
+
+bool MappedSortedKeys::Contains(int64_t value) const {
+  if (header_.count == 0) {
+    return false;
+  }
+  size_t block = FindBlock(value);
+  size_t position = CountLessInBlock(block, value);
+  if (position == GetBlockSize(block)) {
+    // Первый ключ, не меньший 'value', открывает следующий блок.
+    return block + 1 < header_.blocks && GetFirstKey(block + 1) == value;
+  }
+  // Ключ на позиции 'position' - первый не меньший 'value'.
+  if (position == 0) {
+    return GetFirstKey(block) == value;
+  }
+  const unsigned char* data = GetBlockData(block);
+  const unsigned char* end = GetBlockDataEnd(block);
+  int64_t key = GetFirstKey(block);
+  for (size_t i = 0; i < position; ++i) {
+    key = ReadNextKey(key, &data, end);
+  }
+  return key == value;
+}
+
+size_t MappedSortedKeys::Rank(int64_t value) const {
+  if (header_.count == 0) {
+    return 0;
+  }
+  size_t block = FindBlock(value);
+  return block * kSortedKeysBlockSize + CountLessInBlock(block, value);
+}
+
+std::vector<int64_t> MappedSortedKeys::ToSortedArray() const {
+  std::vector<int64_t> res;
+  res.reserve(header_.count);
+  for (size_t block = 0; block < header_.blocks; ++block) {
+    const unsigned char* data = GetBlockData(block);
+    const unsigned char* end = GetBlockDataEnd(block);
+    int64_t key = GetFirstKey(block);
+    res.push_back(key);
+    for (size_t i = 1; i < GetBlockSize(block); ++i) {
+      key = ReadNextKey(key, &data, end);
+      res.push_back(key);
+    }
+  }
+  return res;
+}
+
+size_t MappedSortedKeys::FindBlock(int64_t value) const {
+  // Последний блок, первый ключ которого меньше 'value': все ключи,
+  // меньшие 'value', лежат в нём и в предыдущих блоках.
+  size_t lo = 0;
+  size_t hi = header_.blocks;
+  while (hi - lo > 1) {
+    size_t middle = lo + (hi - lo) / 2;
+    if (GetFirstKey(middle) < value) {
+      lo = middle;
+    } else {
+      hi = middle;
+    }
+  }
+  return lo;
+}
+
+size_t MappedSortedKeys::CountLessInBlock(size_t block, int64_t value) const {
+  int64_t key = GetFirstKey(block);
+  if (key >= value) {
+    return 0;
+  }
+  const unsigned char* data = GetBlockData(block);
+  const unsigned char* end = GetBlockDataEnd(block);
+  size_t block_size = GetBlockSize(block);
+  for (size_t i = 1; i < block_size; ++i) {
+    key = ReadNextKey(key, &data, end);
+    if (key >= value) {
+      return i;
+    }
+  }
+  return block_size;
+}
+
+size_t MappedSortedKeys::GetBlockSize(size_t block) const {
+  return std::min<size_t>(kSortedKeysBlockSize,
+                          header_.count - block * kSortedKeysBlockSize);
+}
+
+int64_t MappedSortedKeys::GetFirstKey(size_t block) const {
+  int64_t key;
+  std::memcpy(&key, &index_[block].first_key, sizeof(key));
+  return key;
+}
+
+uint64_t MappedSortedKeys::GetOffset(size_t block) const {
+  uint64_t offset;
+  std::memcpy(&offset, &index_[block].offset, sizeof(offset));
+  return offset;
+}
+
+const unsigned char* MappedSortedKeys::GetBlockData(size_t block) const {
+  return data_ + GetOffset(block);
+}
+
+const unsigned char* MappedSortedKeys::GetBlockDataEnd(size_t block) const {
+  return data_ + (block + 1 < header_.blocks ? GetOffset(block + 1)
+                                             : header_.data_size);
+}
+
+// Персистентное дерево поиска: каждое изменение создаёт новую версию,
+// а прежние версии остаются доступными и неизменными.
+// Вершины неизменяемы и разделяются версиями через подсчёт ссылок. Add и
+// Erase копируют лишь вершины на пути от корня к изменяемому месту
+// (O(log n) вершин, включая повороты АВЛ-балансировки), всё остальное
+// переиспользуется. Поэтому Snapshot() и копирование дерева выполняются
+// за O(1), а полученный снимок можно читать и обходить из другого потока
+// без блокировок, пока исходное дерево продолжает изменяться.
+template<typename Key, typename Compare = std::less<Key>>
+class PersistentSearchTree {
+ public:
+  using KeyParam =
+      std::conditional_t<std::is_scalar_v<Key>, Key, const Key&>;
+
+  // Итератор по элементам в порядке неубывания. Хранит путь от корня,
+  // то есть O(log n) указателей; действителен, пока жива версия дерева,
+  // из которой он получен.
+  class ConstIterator;
+
+  explicit PersistentSearchTree(const Compare& compare = Compare());
+
+  // Возвращает неизменяемую версию текущего состояния дерева за O(1).
+  PersistentSearchTree Snapshot() const;
+
+  // Возвращает количество элементов в дереве.
+  size_t Size() const;
+
+  // Возвращает высоту дерева (0 для пустого дерева).
+  int Height() const;
+
+  // Метод возвращает "true" если элемент со значением 'value' имеется в дереве
+  // поиска и "false" в противном случае.
+  bool Contains(KeyParam value) const;
+
+  // Помещает значение 'value' в поисковое дерево.
+  void Add(KeyParam value);
+
+  // Удаляет элемент со значением 'value' из поискового дерева.
+  // Если элементов с таким значением несколько, удаляется лишь одно из них.
+  void Erase(KeyParam value);
+
+  // Возвращает массив из элементов, содержащихся в дереве поиска,
+  // расположенными в порядке неубывания.
+  std::vector<Key> ToSortedArray() const;
+
+  ConstIterator begin() const;
+  ConstIterator end() const;
+
+  // Количество вершин, созданных изменениями этой версии и тех, из
+  // которых она получена. Позволяет оценить объём копирования при записи.
+  size_t NodesCreated() const;
+
+ protected:
+  struct Node;
+  using NodePtr = std::shared_ptr<const Node>;
+
+  struct Node {
+    Key value;
+    int height;
+    size_t size;
+    NodePtr left;
+    NodePtr right;
+
+    Node(KeyParam value, NodePtr left, NodePtr right);
+  };
+
+  NodePtr root_;
+  size_t nodes_created_;
+  [[no_unique_address]] Compare compare_;
+
+  static int GetHeight(const NodePtr& node);
+  static size_t GetSize(const NodePtr& node);
+
+  // Создаёт вершину с заданными ключом и детьми.
+  NodePtr MakeNode(KeyParam value, NodePtr left, NodePtr right);
+
+  // Создаёт вершину с заданными ключом и детьми, восстанавливая баланс
+  // поворотами, если высоты детей отличаются на два.
+  NodePtr MakeBalancedNode(KeyParam value, NodePtr left, NodePtr right);
+
+  // Возвращает копию поддерева 'node' с добавленным ключом 'value'.
+  NodePtr Insert(const NodePtr& node, KeyParam value);
+
+  // Возвращает копию поддерева 'node' без одного ключа, равного 'value',
+  // либо само поддерево, если такого ключа нет.
+  NodePtr Remove(const NodePtr& node, KeyParam value);
+
+  // Возвращает копию поддерева 'node' без минимального ключа и
+  // записывает указатель на вершину с ним в *min.
+  NodePtr RemoveMin(const NodePtr& node, const Node** min);
+};
+
+template<typename Key, typename Compare>
+class PersistentSearchTree<Key, Compare>::ConstIterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = Key;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const Key*;
+  using reference = const Key&;
+
+  ConstIterator() = default;
+
+  const Key& operator*() const;
+  const Key* operator->() const;
+
+  ConstIterator& operator++();
+  ConstIterator operator++(int);
+
+  bool operator==(const ConstIterator& other) const;
+  bool operator!=(const ConstIterator& other) const;
+
+ private:
+  friend class PersistentSearchTree;
+
+  // Кладёт в стек вершину 'node' и её левых потомков.
+  void PushLeftPath(const Node* node);
+
+  // Вершины, обход которых начат, но не закончен; текущая - последняя.
+  std::vector<const Node*> path_;
+};
+
+template<typename Key, typename Compare>
+PersistentSearchTree<Key, Compare>::Node::Node(KeyParam value,
+                                               NodePtr left, NodePtr right)
+    : value(value),
+      height(std::max(GetHeight(left), GetHeight(right)) + 1),
+      size(GetSize(left) + GetSize(right) + 1),
+      left(std::move(left)),
+      right(std::move(right)) {}
+
+template<typename Key, typename Compare>
+const Key& PersistentSearchTree<Key, Compare>::ConstIterator::operator*()
+    const {
+  assert(!path_.empty());
+  return path_.back()->value;
+}
+
+template<typename Key, typename Compare>
+const Key* PersistentSearchTree<Key, Compare>::ConstIterator::operator->()
+    const {
+  return &**this;
+}
+
+template<typename Key, typename Compare>
+typename PersistentSearchTree<Key, Compare>::ConstIterator&
+PersistentSearchTree<Key, Compare>::ConstIterator::operator++() {
+  assert(!path_.empty());
+  const Node* node = path_.back();
+  path_.pop_back();
+  PushLeftPath(node->right.get());
+  return *this;
+}
+
+template<typename Key, typename Compare>
+typename PersistentSearchTree<Key, Compare>::ConstIterator
+PersistentSearchTree<Key, Compare>::ConstIterator::operator++(int) {
+  ConstIterator copy = *this;
+  ++*this;
+  return copy;
+}
+
+template<typename Key, typename Compare>
+bool PersistentSearchTree<Key, Compare>::ConstIterator::operator==(
+    const ConstIterator& other) const {
+  return path_.empty() ? other.path_.empty()
+                       : !other.path_.empty()
+                             && path_.back() == other.path_.back();
+}
+
+template<typename Key, typename Compare>
+bool PersistentSearchTree<Key, Compare>::ConstIterator::operator!=(
+    const ConstIterator& other) const {
+  return !(*this == other);
+}
+
+template<typename Key, typename Compare>
+void PersistentSearchTree<Key, Compare>::ConstIterator::PushLeftPath(
+    const Node* node) {
+  for (; node != nullptr; node = node->left.get()) {
+    path_.push_back(node);
+  }
+}
+
+template<typename Key, typename Compare>
+PersistentSearchTree<Key, Compare>::PersistentSearchTree(
+    const Compare& compare)
+    : nodes_created_(0),
+      compare_(compare) {}
+
+template<typename Key, typename Compare>
+PersistentSearchTree<Key, Compare>
+PersistentSearchTree<Key, Compare>::Snapshot() const {
+  return *this;
+}
+
+template<typename Key, typename Compare>
+size_t PersistentSearchTree<Key, Compare>::Size() const {
+  return GetSize(root_);
+}
+
+template<typename Key, typename Compare>
+int PersistentSearchTree<Key, Compare>::Height() const {
+  return GetHeight(root_);
+}
+
+template<typename Key, typename Compare>
+bool PersistentSearchTree<Key, Compare>::Contains(KeyParam value) const {
+  const Node* node = root_.get();
+  while (node != nullptr) {
+    if (compare_(value, node->value)) {
+      node = node->left.get();
+    } else if (compare_(node->value, value)) {
+      node = node->right.get();
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
+
+template<typename Key, typename Compare>
+void PersistentSearchTree<Key, Compare>::Add(KeyParam value) {
+  root_ = Insert(root_, value);
+}
+
+template<typename Key, typename Compare>
+void PersistentSearchTree<Key, Compare>::Erase(KeyParam value) {
+  root_ = Remove(root_, value);
+}
+
+template<typename Key, typename Compare>
+std::vector<Key> PersistentSearchTree<Key, Compare>::ToSortedArray() const {
+  std::vector<Key> res;
+  res.reserve(Size());
+  for (const Key& value : *this) {
+    res.push_back(value);
+  }
+  return res;
+}
+
+template<typename Key, typename Compare>
+typename PersistentSearchTree<Key, Compare>::ConstIterator
+PersistentSearchTree<Key, Compare>::begin() const {
+  ConstIterator it;
+  it.PushLeftPath(root_.get());
+  return it;
+}
+
+template<typename Key, typename Compare>
+typename PersistentSearchTree<Key, Compare>::ConstIterator
+PersistentSearchTree<Key, Compare>::end() const {
+  return ConstIterator();
+}
+
+template<typename Key, typename Compare>
+size_t PersistentSearchTree<Key, Compare>::NodesCreated() const {
+  return nodes_created_;
+}
+
+template<typename Key, typename Compare>
+int PersistentSearchTree<Key, Compare>::GetHeight(const NodePtr& node) {
+  return node == nullptr ? 0 : node->height;
+}
+
+template<typename Key, typename Compare>
+size_t PersistentSearchTree<Key, Compare>::GetSize(const NodePtr& node) {
+  return node == nullptr ? 0 : node->size;
+}
+
+template<typename Key, typename Compare>
+typename PersistentSearchTree<Key, Compare>::NodePtr
+PersistentSearchTree<Key, Compare>::MakeNode(KeyParam value, NodePtr left,
+                                             NodePtr right) {
+  ++nodes_created_;
+  return std::make_shared<const Node>(value, std::move(left),
+                                      std::move(right));
+}
+
+template<typename Key, typename Compare>
+typename PersistentSearchTree<Key, Compare>::NodePtr
+PersistentSearchTree<Key, Compare>::MakeBalancedNode(KeyParam value,
+                                                     NodePtr left,
+                                                     NodePtr right) {
+  if (GetHeight(left) > GetHeight(right) + 1) {
+    if (GetHeight(left->left) >= GetHeight(left->right)) {
+      return MakeNode(left->value, left->left,
+                      MakeNode(value, left->right, std::move(right)));
+    }
+    const Node& pivot = *left->right;
+    return MakeNode(pivot.value, MakeNode(left->value, left->left, pivot.left),
+                    MakeNode(value, pivot.right, std::move(right)));
+  }
+  if (GetHeight(right) > GetHeight(left) + 1) {
+    if (GetHeight(right->right) >= GetHeight(right->left)) {
+      return MakeNode(right->value,
+                      MakeNode(value, std::move(left), right->left),
+                      right->right);
+    }
+    const Node& pivot = *right->left;
+    return MakeNode(pivot.value, MakeNode(value, std::move(left), pivot.left),
+                    MakeNode(right->value, pivot.right, right->right));
+  }
+  return MakeNode(value, std::move(left), std::move(right));
+}
+
+template<typename Key, typename Compare>
+typename PersistentSearchTree<Key, Compare>::NodePtr
+PersistentSearchTree<Key, Compare>::Insert(const NodePtr& node,
+                                           KeyParam value) {
+  if (node == nullptr) {
+    return MakeNode(value, nullptr, nullptr);
+  }
+  if (compare_(value, node->value)) {
+    return MakeBalancedNode(node->value, Insert(node->left, value),
+                            node->right);
+  }
+  return MakeBalancedNode(node->value, node->left,
+                          Insert(node->right, value));
+}
+
+template<typename Key, typename Compare>
+typename PersistentSearchTree<Key, Compare>::NodePtr
+PersistentSearchTree<Key, Compare>::Remove(const NodePtr& node,
+                                           KeyParam value) {
+  if (node == nullptr) {
+    return node;
+  }
+  if (compare_(value, node->value)) {
+    NodePtr left = Remove(node->left, value);
+    return left == node->left
+        ? node
+        : MakeBalancedNode(node->value, std::move(left), node->right);
+  }
+  if (compare_(node->value, value)) {
+    NodePtr right = Remove(node->right, value);
+    return right == node->right
+        ? node
+        : MakeBalancedNode(node->value, node->left, std::move(right));
+  }
+  if (node->left == nullptr) {
+    return node->right;
+  }
+  if (node->right == nullptr) {
+    return node->left;
+  }
+  const Node* min = nullptr;
+  NodePtr right = RemoveMin(node->right, &min);
+  return MakeBalancedNode(min->value, node->left, std::move(right));
+}
+
+template<typename Key, typename Compare>
+typename PersistentSearchTree<Key, Compare>::NodePtr
+PersistentSearchTree<Key, Compare>::RemoveMin(const NodePtr& node,
+                                              const Node** min) {
+  if (node->left == nullptr) {
+    *min = node.get();
+    return node->right;
+  }
+  return MakeBalancedNode(node->value, RemoveMin(node->left, min),
+                          node->right);
+}
+
+// Схема освобождения памяти на основе эпох (epoch-based reclamation).
+// Каждая операция над структурой данных выполняется внутри Guard, который
+// занимает свободную ячейку и объявляет в ней текущую глобальную эпоху.
+// Исключённые из структуры объекты передаются в Retire и удаляются, лишь
+// когда глобальная эпоха продвинулась на две позиции: к этому моменту все
+// операции, которые могли видеть объект, уже завершились.
+class EpochDomain {
+ public:
+  // Максимальное число одновременно выполняемых операций.
+  static constexpr size_t kMaxGuards = 128;
+
+  // Ячейка, занятая операцией на время её выполнения.
+  class Guard {
+   public:
+    explicit Guard(EpochDomain* domain);
+    ~Guard();
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+
+    // Откладывает вызов deleter(object) до момента, когда объект
+    // гарантированно никем не используется.
+    void Retire(void* object, void (*deleter)(void*));
+
+   private:
+    EpochDomain* domain_;
+    size_t slot_;
+  };
+
+  EpochDomain();
+
+  // Удаляет все отложенные объекты. Ни одна операция не должна
+  // выполняться в этот момент.
+  ~EpochDomain();
+
+  EpochDomain(const EpochDomain&) = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+
+ protected:
+  // Число отложенных объектов в ячейке, после которого делается попытка
+  // продвинуть эпоху и удалить накопленное.
+  static constexpr size_t kReclaimThreshold = 64;
+
+  struct Retired {
+    void* object;
+    void (*deleter)(void*);
+    uint64_t epoch;
+  };
+
+  struct alignas(64) Slot {
+    std::atomic<bool> in_use{false};
+    // Эпоха, объявленная операцией, либо 0, если ячейка свободна.
+    std::atomic<uint64_t> epoch{0};
+    // Доступен только операции, занявшей ячейку.
+    std::vector<Retired> retired;
+  };
+
+  std::atomic<uint64_t> global_epoch_;
+  Slot slots_[kMaxGuards];
+
+  // Продвигает глобальную эпоху, если все активные операции её видели.
+  void TryAdvanceEpoch();
+
+  // Удаляет объекты ячейки, отложенные не позже чем две эпохи назад.
+  void Reclaim(Slot* slot);
+};
+
+EpochDomain::Guard::Guard(EpochDomain* domain) : domain_(domain) {
+  // Начинаем поиск со своей для потока позиции, чтобы потоки
+  // не соперничали за одни и те же ячейки.
+  size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+  for (size_t i = 0;; ++i) {
+    slot_ = (start + i) % kMaxGuards;
+    bool expected = false;
+    if (!domain_->slots_[slot_].in_use.load(std::memory_order_relaxed)
+        && domain_->slots_[slot_].in_use.compare_exchange_strong(
+            expected, true, std::memory_order_acquire)) {
+      break;
+    }
+    if (i % kMaxGuards == kMaxGuards - 1) {
+      std::this_thread::yield();
+    }
+  }
+  domain_->slots_[slot_].epoch.store(
+      domain_->global_epoch_.load(std::memory_order_acquire),
+      std::memory_order_relaxed);
+  // Объявление эпохи должно стать видимым до чтения указателей структуры.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+EpochDomain::Guard::~Guard() {
+  Slot& slot = domain_->slots_[slot_];
+  slot.epoch.store(0, std::memory_order_release);
+  slot.in_use.store(false, std::memory_order_release);
+}
+
+void EpochDomain::Guard::Retire(void* object, void (*deleter)(void*)) {
+  Slot& slot = domain_->slots_[slot_];
+  uint64_t epoch = domain_->global_epoch_.load(std::memory_order_acquire);
+  slot.retired.push_back({object, deleter, epoch});
+  if (slot.retired.size() >= kReclaimThreshold) {
+    domain_->TryAdvanceEpoch();
+    domain_->Reclaim(&slot);
+  }
+}
+
+EpochDomain::EpochDomain() : global_epoch_(1) {}
+
+EpochDomain::~EpochDomain() {
+  for (Slot& slot : slots_) {
+    for (const Retired& retired : slot.retired) {
+      retired.deleter(retired.object);
+    }
+  }
+}
+
+void EpochDomain::TryAdvanceEpoch() {
+  uint64_t epoch = global_epoch_.load(std::memory_order_acquire);
+  for (const Slot& slot : slots_) {
+    uint64_t announced = slot.epoch.load(std::memory_order_acquire);
+    if (announced != 0 && announced != epoch) {
+      return;
+    }
+  }
+  global_epoch_.compare_exchange_strong(epoch, epoch + 1,
+                                        std::memory_order_acq_rel);
+}
+
+void EpochDomain::Reclaim(Slot* slot) {
+  uint64_t epoch = global_epoch_.load(std::memory_order_acquire);
+  auto alive = std::partition(
+      slot->retired.begin(), slot->retired.end(),
+      [epoch](const Retired& retired) { return retired.epoch + 2 > epoch; });
+  for (auto it = alive; it != slot->retired.end(); ++it) {
+    it->deleter(it->object);
+  }
+  slot->retired.erase(alive, slot->retired.end());
+}
+
+// Дерево поиска для одновременной работы многих потоков.
+// Устроено как внешнее (листовое) дерево: ключи хранятся в листьях вместе
+// с числом их копий, внутренние вершины лишь направляют поиск. Благодаря
+// этому вставка меняет один указатель в предке листа, а удаление - один
+// указатель в предке предка.
+//  - Contains не берёт блокировок: спускается по атомарным указателям
+//    и читает счётчик копий в листе.
+//  - Add блокирует только родителя листа (или сам лист, если ключ уже
+//    есть), Erase - деда, родителя и лист; блокировки берутся сверху
+//    вниз, поэтому взаимоблокировок не бывает. После захвата проверяется,
+//    что вершины не удалены и по-прежнему связаны; иначе попытка
+//    повторяется.
+//  - Удалённые вершины освобождаются через EpochDomain, поэтому поток,
+//    который ещё спускается по ним, не обратится к освобождённой памяти.
+// В отличие от BinarySearchTree, дерево не балансируется: повороты
+// потребовали бы блокировать целые пути.
+template<typename Key, typename Compare = std::less<Key>>
+class ConcurrentBinarySearchTree {
+  static_assert(std::is_default_constructible_v<Key>,
+                "sentinel nodes need a default-constructed key");
+
+ public:
+  using KeyParam =
+      std::conditional_t<std::is_scalar_v<Key>, Key, const Key&>;
+
+  explicit ConcurrentBinarySearchTree(const Compare& compare = Compare());
+
+  // Ни одна операция не должна выполняться в момент разрушения.
+  ~ConcurrentBinarySearchTree();
+
+  ConcurrentBinarySearchTree(const ConcurrentBinarySearchTree&) = delete;
+  ConcurrentBinarySearchTree& operator=(
+      const ConcurrentBinarySearchTree&) = delete;
+
+  // Возвращает количество элементов в дереве.
+  size_t Size() const;
+
+  // Метод возвращает "true" если элемент со значением 'value' имеется в дереве
+  // поиска и "false" в противном случае.
+  bool Contains(KeyParam value) const;
+
+  // Помещает значение 'value' в поисковое дерево.
+  void Add(KeyParam value);
+
+  // Удаляет элемент со значением 'value' из поискового дерева.
+  // Если элементов с таким значением несколько, удаляется лишь одно из них.
+  void Erase(KeyParam value);
+
+  // Возвращает массив из элементов, содержащихся в дереве поиска,
+  // расположенными в порядке неубывания. Результат согласован, только если
+  // дерево в это время не изменяется.
+  std::vector<Key> ToSortedArray() const;
+
+ protected:
+  // Вершина дерева. У внутренних вершин оба ребёнка не пусты, у листьев
+  // оба пусты. Ключи в левом поддереве меньше ключа вершины, в правом -
+  // не меньше.
+  struct Node {
+    Key value;
+    // 0 для обычного ключа; 1 и 2 для ограничителей, которые больше
+    // любого ключа (второй больше первого).
+    int infinity;
+    bool is_leaf;
+    // Вершина исключена из дерева.
+    std::atomic<bool> removed;
+    // Количество копий ключа в листе.
+    std::atomic<size_t> count;
+    std::atomic<Node*> left;
+    std::atomic<Node*> right;
+    std::mutex mutex;
+
+    // Лист.
+    Node(KeyParam value, int infinity);
+
+    // Внутренняя вершина.
+    Node(KeyParam value, int infinity, Node* left, Node* right);
+  };
+
+  // Результат спуска к листу.
+  struct SearchResult {
+    Node* grandparent;
+    Node* parent;
+    Node* leaf;
+    // Является ли parent левым ребёнком grandparent, leaf - левым
+    // ребёнком parent.
+    bool parent_is_left;
+    bool leaf_is_left;
+  };
+
+  // Корень - внутренняя вершина с ключом "бесконечность 2", слева от неё
+  // лист "бесконечность 1", справа лист "бесконечность 2". Все настоящие
+  // ключи попадают в левое поддерево корня, поэтому у любого настоящего
+  // листа есть и родитель, и дед.
+  Node* root_;
+  std::atomic<size_t> size_;
+  mutable EpochDomain epochs_;
+  [[no_unique_address]] Compare compare_;
+
+  // Проверяет, что 'value' меньше ключа вершины 'node'.
+  bool IsLess(KeyParam value, const Node* node) const;
+
+  // Проверяет, что лист 'node' содержит ключ 'value'.
+  bool IsEqual(KeyParam value, const Node* node) const;
+
+  // Спускается к листу, в котором мог бы находиться ключ 'value'.
+  SearchResult Search(KeyParam value) const;
+
+  static std::atomic<Node*>& GetChild(Node* node, bool left);
+
+  static void DeleteNode(void* node);
+};
+
+template<typename Key, typename Compare>
+ConcurrentBinarySearchTree<Key, Compare>::Node::Node(KeyParam value,
+                                                     int infinity)
+    : value(value),
+      infinity(infinity),
+      is_leaf(true),
+      removed(false),
+      count(infinity == 0 ? 1 : 0),
+      left(nullptr),
+      right(nullptr) {}
+
+template<typename Key, typename Compare>
+ConcurrentBinarySearchTree<Key, Compare>::Node::Node(KeyParam value,
+                                                     int infinity,
+                                                     Node* left, Node* right)
+    : value(value),
+      infinity(infinity),
+      is_leaf(false),
+      removed(false),
+      count(0),
+      left(left),
+      right(right) {}
+
+template<typename Key, typename Compare>
+ConcurrentBinarySearchTree<Key, Compare>::ConcurrentBinarySearchTree(
+    const Compare& compare)
+    : root_(new Node(Key(), 2, new Node(Key(), 1), new Node(Key(), 2))),
+      size_(0),
+      compare_(compare) {}
+
+template<typename Key, typename Compare>
+ConcurrentBinarySearchTree<Key, Compare>::~ConcurrentBinarySearchTree() {
+  std::vector<Node*> stack = {root_};
+  while (!stack.empty()) {
+    Node* node = stack.back();
+    stack.pop_back();
+    if (!node->is_leaf) {
+      stack.push_back(node->left.load(std::memory_order_relaxed));
+      stack.push_back(node->right.load(std::memory_order_relaxed));
+    }
+    delete node;
+  }
+}
+
+template<typename Key, typename Compare>
+size_t ConcurrentBinarySearchTree<Key, Compare>::Size() const {
+  return size_.load(std::memory_order_relaxed);
+}
+
+template<typename Key, typename Compare>
+bool ConcurrentBinarySearchTree<Key, Compare>::Contains(KeyParam value) const {
+  EpochDomain::Guard guard(&epochs_);
+  const Node* leaf = Search(value).leaf;
+  return IsEqual(value, leaf)
+      && leaf->count.load(std::memory_order_acquire) != 0;
+}
+
+template<typename Key, typename Compare>
+void ConcurrentBinarySearchTree<Key, Compare>::Add(KeyParam value) {
+  EpochDomain::Guard guard(&epochs_);
+  while (true) {
+    SearchResult found = Search(value);
+    Node* leaf = found.leaf;
+    if (IsEqual(value, leaf)) {
+      std::lock_guard<std::mutex> leaf_lock(leaf->mutex);
+      if (leaf->removed.load(std::memory_order_relaxed)) {
+        continue;
+      }
+      leaf->count.fetch_add(1, std::memory_order_release);
+      break;
+    }
+
+    // Новый лист и вершина, разделяющая его и найденный лист.
+    Node* new_leaf = new Node(value, 0);
+    Node* new_parent = IsLess(value, leaf)
+        ? new Node(leaf->value, leaf->infinity, new_leaf, leaf)
+        : new Node(value, 0, leaf, new_leaf);
+    {
+      std::lock_guard<std::mutex> parent_lock(found.parent->mutex);
+      std::atomic<Node*>& link = GetChild(found.parent, found.leaf_is_left);
+      if (!found.parent->removed.load(std::memory_order_relaxed)
+          && link.load(std::memory_order_relaxed) == leaf) {
+        link.store(new_parent, std::memory_order_release);
+        new_parent = nullptr;
+      }
+    }
+    if (new_parent == nullptr) {
+      break;
+    }
+    delete new_parent;
+    delete new_leaf;
+  }
+  size_.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<typename Key, typename Compare>
+void ConcurrentBinarySearchTree<Key, Compare>::Erase(KeyParam value) {
+  EpochDomain::Guard guard(&epochs_);
+  while (true) {
+    SearchResult found = Search(value);
+    if (!IsEqual(value, found.leaf)) {
+      return;
+    }
+    std::unique_lock<std::mutex> grandparent_lock(found.grandparent->mutex);
+    std::unique_lock<std::mutex> parent_lock(found.parent->mutex);
+    std::unique_lock<std::mutex> leaf_lock(found.leaf->mutex);
+    std::atomic<Node*>& link =
+        GetChild(found.grandparent, found.parent_is_left);
+    if (found.grandparent->removed.load(std::memory_order_relaxed)
+        || link.load(std::memory_order_relaxed) != found.parent
+        || found.parent->removed.load(std::memory_order_relaxed)
+        || GetChild(found.parent, found.leaf_is_left)
+               .load(std::memory_order_relaxed) != found.leaf
+        || found.leaf->removed.load(std::memory_order_relaxed)) {
+      continue;
+    }
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    if (found.leaf->count.load(std::memory_order_relaxed) > 1) {
+      found.leaf->count.fetch_sub(1, std::memory_order_release);
+      return;
+    }
+    found.leaf->count.store(0, std::memory_order_release);
+    Node* sibling = GetChild(found.parent, !found.leaf_is_left)
+        .load(std::memory_order_relaxed);
+    link.store(sibling, std::memory_order_release);
+    found.parent->removed.store(true, std::memory_order_relaxed);
+    found.leaf->removed.store(true, std::memory_order_relaxed);
+    leaf_lock.unlock();
+    parent_lock.unlock();
+    grandparent_lock.unlock();
+    guard.Retire(found.parent, &DeleteNode);
+    guard.Retire(found.leaf, &DeleteNode);
+    return;
+  }
+}
+
+template<typename Key, typename Compare>
+std::vector<Key> ConcurrentBinarySearchTree<Key, Compare>::ToSortedArray()
+    const {
+  EpochDomain::Guard guard(&epochs_);
+  std::vector<Key> res;
+  std::vector<const Node*> stack = {root_};
+  while (!stack.empty()) {
+    const Node* node = stack.back();
+    stack.pop_back();
+    if (node->is_leaf) {
+      size_t count = node->count.load(std::memory_order_acquire);
+      res.insert(res.end(), count, node->value);
+    } else {
+      stack.push_back(node->right.load(std::memory_order_acquire));
+      stack.push_back(node->left.load(std::memory_order_acquire));
+    }
+  }
+  return res;
+}
+
+template<typename Key, typename Compare>
+bool ConcurrentBinarySearchTree<Key, Compare>::IsLess(KeyParam value,
+                                                      const Node* node) const {
+  return node->infinity != 0 || compare_(value, node->value);
+}
+
+template<typename Key, typename Compare>
+bool ConcurrentBinarySearchTree<Key, Compare>::IsEqual(
+    KeyParam value, const Node* node) const {
+  return node->infinity == 0 && !compare_(value, node->value)
+      && !compare_(node->value, value);
+}
+
+template<typename Key, typename Compare>
+typename ConcurrentBinarySearchTree<Key, Compare>::SearchResult
+ConcurrentBinarySearchTree<Key, Compare>::Search(KeyParam value) const {
+  SearchResult result{nullptr, nullptr, root_, false, false};
+  while (!result.leaf->is_leaf) {
+    result.grandparent = result.parent;
+    result.parent_is_left = result.leaf_is_left;
+    result.parent = result.leaf;
+    result.leaf_is_left = IsLess(value, result.parent);
+    result.leaf = GetChild(result.parent, result.leaf_is_left)
+        .load(std::memory_order_acquire);
+  }
+  return result;
+}
+
+template<typename Key, typename Compare>
+std::atomic<typename ConcurrentBinarySearchTree<Key, Compare>::Node*>&
+ConcurrentBinarySearchTree<Key, Compare>::GetChild(Node* node, bool left) {
+  return left ? node->left : node->right;
+}
+
+template<typename Key, typename Compare>
+void ConcurrentBinarySearchTree<Key, Compare>::DeleteNode(void* node) {
+  delete static_cast<Node*>(node);
+}
+
+#ifndef IGNORE_MAIN
+template<typename Func>
+double MeasureMilliseconds(Func func) {
+  auto start = std::chrono::steady_clock::now();
+  func();
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+// Текущий объём резидентной памяти процесса в килобайтах (Linux),
+// либо 0, если он недоступен.
+size_t ResidentSetKilobytes() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("VmRSS:", 0) == 0) {
+      return std::stoul(line.substr(6));
+    }
+  }
+  return 0;
+}
+
+// Просит ядро вытеснить страницы файла 'path' из кэша, чтобы следующее
+// чтение шло с диска, как при холодном старте процесса.
+void DropFileCache(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+}
+
+int main() {
+  const int kQueriesCount = 50'000;
+  const std::vector<int>
+      kElementsMaxValues({1, 2, 5, 13, 42, 1024, 1'000'000'000});
+
+  std::mt19937_64 random_generator(2018);
+  // Отдельный генератор для запросов порядковых статистик, чтобы
+  // не менять последовательность основных запросов.
+  std::mt19937_64 order_generator(2019);
+  for (const int max_element_value : kElementsMaxValues) {
+    std::vector<int> elements;
+    BinarySearchTree<int> tree;
+    for (int i = 0; i < kQueriesCount; ++i) {
+      int query_type = static_cast<int>(random_generator() % 3);
+      switch (query_type) {
+        case 0: {
+          int value;
+          if (elements.empty() || random_generator() % 100 < 75) {
+            value = static_cast<int>(random_generator() % max_element_value);
+            value -= max_element_value / 2;
+          } else {
+            value = elements[random_generator() % elements.size()];
+          }
+
+          elements.push_back(value);
+          sort(elements.begin(), elements.end());  // Never do like this :)
+          tree.Add(value);
+          break;
+        }
+        case 1: {
+          int value;
+          if (elements.empty() || random_generator() % 100 < 40) {
+            value = static_cast<int>(random_generator() % max_element_value);
+            value -= max_element_value / 2;
+          } else {
+            value = elements[random_generator() % elements.size()];
+          }
+
+          bool result = tree.Contains(value);
+          bool expected_result =
+              std::find(elements.begin(), elements.end(), value)
+                  != elements.end();
+          assert(result == expected_result);
+          break;
+        }
+        case 2: {
+          int value;
           if (elements.empty() || random_generator() % 100 < 25) {
             value = static_cast<int>(random_generator() % max_element_value);
             value -= max_element_value / 2;
@@ -264,11 +2766,1122 @@ int main() {
 
       assert(elements.size() == tree.Size());
       assert(elements == tree.ToSortedArray());
+      assert(tree.Height() <= 1.45 * std::log2(tree.Size() + 2));
+
+      {
+        int lo = static_cast<int>(order_generator() % max_element_value)
+            - max_element_value / 2;
+        int hi = static_cast<int>(order_generator() % max_element_value)
+            - max_element_value / 2;
+        if (order_generator() % 4 == 0) {
+          std::swap(lo, hi);
+        }
+        auto lower = std::lower_bound(elements.begin(), elements.end(), lo);
+        auto upper = std::upper_bound(elements.begin(), elements.end(), hi);
+        assert(tree.Rank(lo) == size_t(lower - elements.begin()));
+        if (!elements.empty()) {
+          size_t k = order_generator() % elements.size();
+          assert(tree.KthSmallest(k) == elements[k]);
+        }
+        size_t expected_count = lo <= hi ? upper - lower : 0;
+        assert(tree.CountInRange(lo, hi) == expected_count);
+        std::vector<int> range;
+        for (int value : tree.GetRange(lo, hi)) {
+          range.push_back(value);
+        }
+        assert(range == std::vector<int>(lower, lower + expected_count));
+      }
+
+      if (i % 1000 == 0) {
+        StaticSearchTree static_tree(tree);
+        assert(static_tree.Size() == elements.size());
+        assert(static_tree.ToSortedArray() == elements);
+        for (int j = -2; j < 40; ++j) {
+          int value = static_cast<int>(random_generator() % max_element_value)
+              - max_element_value / 2;
+          assert(static_tree.Contains(value) == std::binary_search(
+              elements.begin(), elements.end(), value));
+        }
+      }
     }
 
     std::cout << "Passed: max_element_value = " << max_element_value << std::endl;
   }
 
+  {
+    // Отсортированная последовательность не вырождает дерево в список.
+    const int kSortedCount = 100'000;
+    BinarySearchTree<int> tree;
+    for (int i = 0; i < kSortedCount; ++i) {
+      tree.Add(i / 3);
+    }
+    assert(tree.Height() <= 1.45 * std::log2(kSortedCount + 2));
+    for (int i = 0; i < kSortedCount; i += 2) {
+      tree.Erase(i / 3);
+    }
+    assert(tree.Size() == kSortedCount / 2);
+    assert(tree.Height() <= 1.45 * std::log2(kSortedCount / 2 + 2));
+    std::vector<int> sorted = tree.ToSortedArray();
+    assert(std::is_sorted(sorted.begin(), sorted.end()));
+    std::cout << "Passed: sorted insertions" << std::endl;
+  }
+
+  {
+    // Двунаправленные итераторы и границы против std::multiset.
+    std::mt19937 iterator_generator(2022);
+    BinarySearchTree<int> tree;
+    std::multiset<int> reference;
+    assert(tree.begin() == tree.end());
+    assert(tree.LowerBound(0) == tree.end());
+    for (int i = 0; i < 2000; ++i) {
+      int value = iterator_generator() % 500;
+      tree.Add(value);
+      reference.insert(value);
+    }
+    assert(std::equal(tree.begin(), tree.end(), reference.begin(),
+                      reference.end()));
+    assert(std::equal(std::make_reverse_iterator(tree.end()),
+                      std::make_reverse_iterator(tree.begin()),
+                      reference.rbegin(), reference.rend()));
+    for (int value = -1; value <= 501; ++value) {
+      auto lower = tree.LowerBound(value);
+      auto upper = tree.UpperBound(value);
+      assert(size_t(std::distance(tree.begin(), lower)) == tree.Rank(value));
+      assert(size_t(std::distance(lower, upper)) == reference.count(value));
+      assert(lower == tree.end() || *lower >= value);
+      if (lower != tree.begin()) {
+        assert(*std::prev(lower) < value);
+      }
+      assert(upper == tree.end() || *upper > value);
+      if (upper != tree.begin()) {
+        assert(*std::prev(upper) <= value);
+      }
+    }
+    std::cout << "Passed: iterators" << std::endl;
+  }
+
+  {
+    // Пакетный поиск совпадает с поэлементным, включая пакеты меньше
+    // числа одновременных спусков.
+    std::mt19937 batch_generator(2023);
+    BinarySearchTree<int> tree;
+    BinarySearchTree<std::string> string_tree;
+    for (int i = 0; i < 5000; ++i) {
+      int value = batch_generator() % 10000;
+      tree.Add(value);
+      string_tree.Add(std::to_string(value));
+    }
+    for (size_t count : {0, 1, 31, 32, 33, 20000}) {
+      std::vector<int> keys(count);
+      std::vector<std::string> string_keys(count);
+      for (size_t i = 0; i < count; ++i) {
+        keys[i] = batch_generator() % 10000;
+        string_keys[i] = std::to_string(keys[i]);
+      }
+      std::unique_ptr<bool[]> found(new bool[count + 1]);
+      tree.ContainsBatch(keys.data(), count, found.get());
+      for (size_t i = 0; i < count; ++i) {
+        assert(found[i] == tree.Contains(keys[i]));
+      }
+      string_tree.ContainsBatch(string_keys.data(), count, found.get());
+      for (size_t i = 0; i < count; ++i) {
+        assert(found[i] == tree.Contains(keys[i]));
+      }
+    }
+    bool found = true;
+    const int kKey = 1;
+    BinarySearchTree<int>().ContainsBatch(&kKey, 1, &found);
+    assert(!found);
+    std::cout << "Passed: batched lookups" << std::endl;
+  }
+
+  {
+    // Удалённые вершины переиспользуются, Clear() освобождает всё дерево.
+    BinarySearchTree<int> tree;
+    for (size_t round = 0; round < 3; ++round) {
+      for (int i = 0; i < 1000; ++i) {
+        tree.Add(i);
+      }
+      for (int i = 0; i < 1000; i += 2) {
+        tree.Erase(i);
+      }
+      assert(tree.Size() == 500 * (round + 1));
+    }
+    tree.Clear();
+    assert(tree.Size() == 0 && tree.ToSortedArray().empty());
+    assert(!tree.Contains(1));
+    tree.Add(7);
+    tree.Add(7);
+    assert(tree.ToSortedArray() == std::vector<int>({7, 7}));
+    std::cout << "Passed: node pool" << std::endl;
+  }
+
+  {
+    // Ключи других типов и собственный компаратор.
+    BinarySearchTree<int64_t> wide;
+    wide.Add(int64_t(1) << 40);
+    wide.Add(-(int64_t(1) << 40));
+    assert(wide.Contains(int64_t(1) << 40) && !wide.Contains(0));
+    assert(wide.KthSmallest(0) == -(int64_t(1) << 40));
+
+    BinarySearchTree<double> doubles;
+    for (double value : {2.5, -1.0, 0.25, 2.5}) {
+      doubles.Add(value);
+    }
+    assert(doubles.ToSortedArray()
+               == std::vector<double>({-1, 0.25, 2.5, 2.5}));
+    assert(doubles.CountInRange(0.0, 3.0) == 3);
+
+    BinarySearchTree<int, std::greater<int>> descending;
+    for (int value : {3, 1, 4, 1, 5}) {
+      descending.Add(value);
+    }
+    assert(descending.ToSortedArray() == std::vector<int>({5, 4, 3, 1, 1}));
+    assert(descending.Rank(3) == 2);
+    descending.Erase(1);
+    assert(descending.ToSortedArray() == std::vector<int>({5, 4, 3, 1}));
+  }
+  {
+    // Строковые ключи и поиск по std::string_view без создания std::string.
+    BinarySearchTree<std::string, std::less<>> strings;
+    std::vector<std::string> words = {
+        "pear", "apple", "a rather long key that does not fit into SSO",
+        "plum", "apple"};
+    for (const std::string& word : words) {
+      strings.Add(word);
+    }
+    std::sort(words.begin(), words.end());
+    assert(strings.ToSortedArray() == words);
+    assert(strings.Contains(std::string_view("plum")));
+    assert(strings.Contains("pear"));
+    assert(!strings.Contains(std::string_view("plu")));
+    std::string_view long_key = words[0];
+    assert(strings.Contains(long_key));
+    strings.Erase("apple");
+    assert(strings.Contains("apple") && strings.Size() == 4);
+    for (int i = 0; i < 1000; ++i) {
+      strings.Add(std::to_string(i) + words[0]);
+    }
+    for (int i = 0; i < 1000; i += 2) {
+      strings.Erase(std::to_string(i) + words[0]);
+    }
+    strings.Add("after erase");
+    assert(strings.Size() == 505);
+    strings.Clear();
+    assert(strings.Size() == 0 && !strings.Contains("pear"));
+    strings.Add("pear");
+    assert(strings.Contains("pear"));
+  }
+  {
+    // Отображение: к ключу приложено значение.
+    BinarySearchMap<std::string, std::vector<int>> map;
+    map.Add("one", {1});
+    map.Add("three", {1, 1, 1});
+    assert(map.Get("one") != nullptr && *map.Get("one") == std::vector<int>{1});
+    assert(map.Get("two") == nullptr);
+    map.Get("three")->push_back(1);
+    std::vector<size_t> sizes;
+    for (auto it = map.GetRange("a", "z").begin();
+         it != map.GetRange("a", "z").end(); ++it) {
+      sizes.push_back(it.GetMapped().size());
+    }
+    assert(sizes == std::vector<size_t>({1, 4}));
+    map.Erase("one");
+    assert(map.Get("one") == nullptr && map.Size() == 1);
+    std::cout << "Passed: key types" << std::endl;
+  }
+
+  {
+    // Построение из отсортированного массива, разделение и слияние.
+    std::mt19937_64 random_generator(2018);
+    auto is_balanced = [](const BinarySearchTree<int>& tree) {
+      return tree.Height() <= 1.45 * std::log2(tree.Size() + 2);
+    };
+    for (const int max_element_value : {5, 1024, 1'000'000}) {
+      for (size_t size : {0, 1, 2, 3, 100, 5000}) {
+        std::vector<int> elements(size);
+        for (int& value : elements) {
+          value = static_cast<int>(random_generator() % max_element_value);
+        }
+        std::sort(elements.begin(), elements.end());
+        BinarySearchTree<int> tree;
+        tree.Add(42);
+        tree.BuildFromSorted(elements.begin(), elements.end());
+        assert(tree.ToSortedArray() == elements);
+        assert(tree.Height() <= std::ceil(std::log2(size + 1)));
+        for (size_t k = 0; k < size; k += 7) {
+          assert(tree.KthSmallest(k) == elements[k]);
+        }
+
+        int key = static_cast<int>(random_generator() % max_element_value);
+        BinarySearchTree<int> right = tree.Split(key);
+        auto middle = std::lower_bound(elements.begin(), elements.end(), key);
+        assert(tree.ToSortedArray() == std::vector<int>(elements.begin(),
+                                                        middle));
+        assert(right.ToSortedArray() == std::vector<int>(middle,
+                                                         elements.end()));
+        assert(is_balanced(tree) && is_balanced(right));
+        assert(right.Rank(key) == 0);
+
+        // Деревья делят пул: удалённые из одного вершины достаются другому.
+        if (right.Size() != 0) {
+          right.Erase(right.KthSmallest(0));
+          tree.Add(key - 1);
+          right.Add(key);
+        }
+        tree.Merge(right);
+        assert(right.Size() == 0 && right.ToSortedArray().empty());
+        std::vector<int> merged = tree.ToSortedArray();
+        assert(merged.size() == tree.Size());
+        assert(std::is_sorted(merged.begin(), merged.end()));
+        assert(is_balanced(tree));
+      }
+
+      // Слияние деревьев с пересекающимися ключами и разными пулами.
+      BinarySearchTree<int> first;
+      BinarySearchTree<int> second;
+      std::vector<int> elements;
+      for (int i = 0; i < 3000; ++i) {
+        int value = static_cast<int>(random_generator() % max_element_value);
+        (i % 3 == 0 ? first : second).Add(value);
+        elements.push_back(value);
+      }
+      std::sort(elements.begin(), elements.end());
+      BinarySearchTree<int> third = second.Split(max_element_value / 2);
+      second.Merge(first);
+      assert(first.Size() == 0);
+      first.Add(1);
+      assert(first.ToSortedArray() == std::vector<int>({1}));
+      // Пул 'third' общий со 'second', поэтому вершины копируются.
+      BinarySearchTree<int> fourth;
+      fourth.Merge(third);
+      fourth.Merge(second);
+      assert(fourth.ToSortedArray() == elements);
+      assert(is_balanced(fourth));
+      for (int i = 0; i < 100; ++i) {
+        fourth.Erase(elements[i * 7]);
+      }
+      assert(fourth.Size() == elements.size() - 100);
+
+      // Оба дерева после Split изменяются независимо, и каждое остаётся
+      // рабочим после разрушения другого.
+      {
+        BinarySearchTree<int> lower;
+        for (int i = 0; i < 1000; ++i) {
+          lower.Add(i);
+        }
+        std::set<int> lower_expected;
+        std::set<int> upper_expected;
+        {
+          BinarySearchTree<int> upper = lower.Split(500);
+          for (int i = 0; i < 1000; ++i) {
+            (i < 500 ? lower_expected : upper_expected).insert(i);
+          }
+          for (int i = 0; i < 1000; i += 3) {
+            lower.Erase(i);
+            upper.Erase(i);
+            lower_expected.erase(i);
+            upper_expected.erase(i);
+          }
+          for (int i = 0; i < 300; ++i) {
+            lower.Add(-i);
+            upper.Add(1000 + i);
+            lower_expected.insert(-i);
+            upper_expected.insert(1000 + i);
+          }
+          assert(upper.ToSortedArray() == std::vector<int>(
+              upper_expected.begin(), upper_expected.end()));
+          assert(is_balanced(upper));
+        }
+        for (int i = 0; i < 300; ++i) {
+          lower.Add(-1000 - i);
+          lower_expected.insert(-1000 - i);
+        }
+        assert(lower.ToSortedArray() == std::vector<int>(
+            lower_expected.begin(), lower_expected.end()));
+        assert(is_balanced(lower));
+      }
+
+      // Слияние деревьев с непересекающимися ключами в обе стороны,
+      // в том числе с равными граничными ключами и разными высотами.
+      for (int low_size : {1, 7, 3000}) {
+        BinarySearchTree<int> low;
+        BinarySearchTree<int> high;
+        std::vector<int> expected;
+        for (int i = 0; i < low_size; ++i) {
+          low.Add(i);
+          expected.push_back(i);
+        }
+        for (int i = 0; i < 500; ++i) {
+          high.Add(low_size - 1 + i);
+          expected.push_back(low_size - 1 + i);
+        }
+        std::sort(expected.begin(), expected.end());
+        BinarySearchTree<int> high_copy = high.Split(low_size - 1);
+        low.Merge(high_copy);
+        assert(low.ToSortedArray() == expected);
+        assert(is_balanced(low));
+        BinarySearchTree<int> low_part = low.Split(low_size - 1);
+        low_part.Merge(low);
+        assert(low_part.ToSortedArray() == expected);
+        assert(is_balanced(low_part));
+      }
+
+      // Слияние в дерево без блоков пула: новое и очищенное.
+      for (bool cleared : {false, true}) {
+        BinarySearchTree<int> target;
+        if (cleared) {
+          target.Add(1);
+          target.Clear();
+        }
+        BinarySearchTree<int> source;
+        std::vector<int> expected;
+        for (int i = 0; i < 10; ++i) {
+          source.Add(i * 10);
+          expected.push_back(i * 10);
+        }
+        target.Merge(source);
+        for (int i = 0; i < 100; ++i) {
+          target.Add(i * 10 + 5);
+          expected.push_back(i * 10 + 5);
+        }
+        std::sort(expected.begin(), expected.end());
+        assert(target.ToSortedArray() == expected);
+        assert(is_balanced(target));
+      }
+    }
+
+    BinarySearchMap<std::string, int> map;
+    std::vector<std::string> keys = {"a", "b", "c", "d"};
+    map.BuildFromSorted(keys.begin(), keys.end());
+    *map.Get("c") = 3;
+    BinarySearchMap<std::string, int> upper = map.Split("c");
+    assert(*upper.Get("c") == 3 && map.Get("c") == nullptr);
+    BinarySearchMap<std::string, int> other;
+    other.Add("bb", 2);
+    upper.Merge(other);
+    upper.Merge(map);
+    assert(upper.ToSortedArray()
+           == std::vector<std::string>({"a", "b", "bb", "c", "d"}));
+    assert(*upper.Get("bb") == 2 && *upper.Get("c") == 3);
+    std::cout << "Passed: build, split and merge" << std::endl;
+  }
+
+  {
+    // Крайние значения и размеры, не кратные размеру блока.
+    const int kMin = std::numeric_limits<int>::min();
+    const int kMax = std::numeric_limits<int>::max();
+    assert(!StaticSearchTree().Contains(0));
+    assert(!StaticSearchTree().Contains(kMax));
+    for (int size : {1, 15, 16, 17, 272, 289, 5000}) {
+      std::vector<int> sorted;
+      for (int i = 0; i < size; ++i) {
+        sorted.push_back(kMin + 2 * i);
+      }
+      StaticSearchTree static_tree(sorted);
+      assert(static_tree.ToSortedArray() == sorted);
+      for (int i = 0; i < size; ++i) {
+        assert(static_tree.Contains(kMin + 2 * i));
+        assert(!static_tree.Contains(kMin + 2 * i + 1));
+      }
+      assert(!static_tree.Contains(kMax));
+      sorted.push_back(kMax);
+      sorted.push_back(kMax);
+      assert(StaticSearchTree(sorted).Contains(kMax));
+      assert(StaticSearchTree(sorted).ToSortedArray() == sorted);
+    }
+    std::cout << "Passed: static search tree" << std::endl;
+  }
+
+  {
+    // Сохранение в файл и поиск в отображённом файле.
+    const std::string kPath = "search_tree_keys.bin";
+    const int kMin = std::numeric_limits<int>::min();
+    const int kMax = std::numeric_limits<int>::max();
+    std::mt19937 serialize_generator(2020);
+    for (int size : {0, 1, 127, 128, 129, 5000}) {
+      BinarySearchTree<int> tree;
+      std::multiset<int> reference;
+      for (int i = 0; i < size; ++i) {
+        int value = i < 2 ? (i == 0 ? kMin : kMax)
+                          : static_cast<int>(serialize_generator()) % 1000;
+        tree.Add(value);
+        reference.insert(value);
+      }
+      {
+        std::ofstream out(kPath, std::ios::binary);
+        tree.Serialize(out);
+      }
+      MappedSortedKeys view(kPath);
+      assert(view.Size() == tree.Size());
+      std::vector<int64_t> expected(reference.begin(), reference.end());
+      assert(view.ToSortedArray() == expected);
+      for (int64_t value : {int64_t(kMin), int64_t(kMin) + 1, int64_t(-1000),
+                            int64_t(kMax), int64_t(kMax) + 1}) {
+        assert(view.Contains(value) == std::binary_search(
+            expected.begin(), expected.end(), value));
+        assert(view.Rank(value) == size_t(std::lower_bound(
+            expected.begin(), expected.end(), value) - expected.begin()));
+      }
+      for (int value = -1000; value <= 1000; ++value) {
+        assert(view.Contains(value) == tree.Contains(value));
+        assert(view.Rank(value) == tree.Rank(value));
+      }
+      BinarySearchTree<int> loaded;
+      loaded.BuildFromSorted(expected.begin(), expected.end());
+      assert(loaded.ToSortedArray() == tree.ToSortedArray());
+    }
+    {
+      std::ofstream out(kPath, std::ios::binary);
+      out << "not a tree";
+    }
+    bool thrown = false;
+    try {
+      MappedSortedKeys view(kPath);
+    } catch (const std::runtime_error&) {
+      thrown = true;
+    }
+    assert(thrown);
+
+    // Повреждённые файлы: заголовок и индекс отвергаются при открытии,
+    // испорченные разности - при декодировании блока.
+    auto write_keys = [&](uint64_t count,
+                          const std::vector<SortedKeysIndexEntry>& index,
+                          const std::string& data) {
+      SortedKeysHeader header = {};
+      std::copy(std::begin(kSortedKeysMagic), std::end(kSortedKeysMagic),
+                header.magic);
+      header.count = count;
+      header.blocks = index.size();
+      header.block_size = kSortedKeysBlockSize;
+      header.data_size = data.size();
+      std::ofstream out(kPath, std::ios::binary);
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      out.write(reinterpret_cast<const char*>(index.data()),
+                index.size() * sizeof(SortedKeysIndexEntry));
+      out.write(data.data(), data.size());
+    };
+    auto is_rejected = [&] {
+      try {
+        MappedSortedKeys view(kPath);
+      } catch (const std::runtime_error&) {
+        return true;
+      }
+      return false;
+    };
+    auto is_corrupt = [&] {
+      MappedSortedKeys view(kPath);
+      try {
+        view.ToSortedArray();
+      } catch (const std::runtime_error&) {
+        return true;
+      }
+      return false;
+    };
+    write_keys(3, {{5, 0}}, std::string("\x01\x02", 2));
+    assert(MappedSortedKeys(kPath).ToSortedArray()
+           == std::vector<int64_t>({5, 6, 8}));
+    write_keys(2, {{5, uint64_t(1) << 40}}, std::string(4040, '\0'));
+    assert(is_rejected());
+    write_keys(std::numeric_limits<uint64_t>::max(), {}, "");
+    assert(is_rejected());
+    write_keys(129, {{10, 0}, {5, 127}}, std::string(127, '\0'));
+    assert(is_rejected());
+    write_keys(129, {{5, 0}, {10, 100}}, std::string(127, '\0'));
+    assert(is_rejected());
+    write_keys(3, {{5, 0}}, std::string("\x01\x81", 2));
+    assert(is_rejected());
+    write_keys(3, {{5, 0}}, std::string("\x81\x01", 2));
+    assert(is_corrupt());
+    write_keys(3, {{5, 0}}, std::string(11, '\x80') + '\x01' + '\x01');
+    assert(is_corrupt());
+    std::remove(kPath.c_str());
+    std::cout << "Passed: serialization" << std::endl;
+  }
+
+  {
+    // Снимки персистентного дерева не меняются при последующих изменениях.
+    std::mt19937_64 random_generator(2018);
+    for (const int max_element_value : {5, 1024, 1'000'000}) {
+      PersistentSearchTree<int> tree;
+      std::vector<int> elements;
+      std::vector<std::pair<PersistentSearchTree<int>, std::vector<int>>>
+          snapshots;
+      for (int i = 0; i < 5000; ++i) {
+        int value = static_cast<int>(random_generator() % max_element_value);
+        if (random_generator() % 3 != 0) {
+          elements.insert(std::upper_bound(elements.begin(), elements.end(),
+                                           value),
+                          value);
+          tree.Add(value);
+        } else {
+          auto element_it =
+              std::lower_bound(elements.begin(), elements.end(), value);
+          if (element_it != elements.end() && *element_it == value) {
+            elements.erase(element_it);
+          }
+          tree.Erase(value);
+        }
+        assert(tree.Size() == elements.size());
+        assert(tree.Contains(value) == std::binary_search(
+            elements.begin(), elements.end(), value));
+        assert(tree.Height() <= 1.45 * std::log2(tree.Size() + 2));
+        if (i % 500 == 0) {
+          snapshots.emplace_back(tree.Snapshot(), elements);
+        }
+      }
+      assert(tree.ToSortedArray() == elements);
+      for (const auto& [snapshot, snapshot_elements] : snapshots) {
+        assert(snapshot.ToSortedArray() == snapshot_elements);
+      }
+    }
+
+    // Чтение снимка из другого потока, пока дерево изменяется.
+    PersistentSearchTree<std::string> strings;
+    for (int i = 0; i < 1000; ++i) {
+      strings.Add(std::to_string(i));
+    }
+    PersistentSearchTree<std::string> snapshot = strings.Snapshot();
+    std::thread reader([&snapshot] {
+      for (int round = 0; round < 20; ++round) {
+        size_t count = 0;
+        for (auto it = snapshot.begin(); it != snapshot.end(); ++it) {
+          assert(it->size() <= 3);
+          ++count;
+        }
+        assert(count == 1000 && snapshot.Contains("999"));
+      }
+    });
+    for (int i = 0; i < 1000; ++i) {
+      strings.Erase(std::to_string(i));
+      strings.Add("new " + std::to_string(i));
+    }
+    reader.join();
+    assert(strings.Size() == 1000 && !strings.Contains("999"));
+    std::cout << "Passed: persistent snapshots" << std::endl;
+  }
+
+  {
+    // Тот же сценарий, что и выше, но одновременно в нескольких потоках.
+    // Поток t работает с ключами, сравнимыми с t по модулю kThreads, поэтому
+    // ответы Contains для своих ключей он может проверить точно, хотя
+    // структура дерева общая. Отдельный поток всё это время читает
+    // произвольные ключи.
+    const int kThreads = 8;
+    const int kThreadQueriesCount = 20'000;
+    for (const int max_element_value : {5, 1024, 1'000'000}) {
+      ConcurrentBinarySearchTree<int> tree;
+      std::vector<std::vector<int>> thread_elements(kThreads);
+      std::atomic<bool> writers_done(false);
+
+      std::thread reader([&tree, &writers_done, max_element_value] {
+        std::mt19937 generator(1);
+        size_t found = 0;
+        while (!writers_done.load()) {
+          int value = static_cast<int>(generator() % max_element_value);
+          found += tree.Contains((value - max_element_value / 2) * kThreads);
+        }
+        assert(found < std::numeric_limits<size_t>::max());
+      });
+
+      std::vector<std::thread> writers;
+      for (int t = 0; t < kThreads; ++t) {
+        writers.emplace_back([&tree, &thread_elements, max_element_value, t] {
+          std::mt19937_64 random_generator(2018 + t);
+          std::vector<int>& elements = thread_elements[t];
+          auto random_value = [&](uint64_t percent_existing) {
+            if (elements.empty()
+                || random_generator() % 100 >= percent_existing) {
+              int value =
+                  static_cast<int>(random_generator() % max_element_value)
+                  - max_element_value / 2;
+              return value * kThreads + t;
+            }
+            return elements[random_generator() % elements.size()];
+          };
+          for (int i = 0; i < kThreadQueriesCount; ++i) {
+            switch (random_generator() % 3) {
+              case 0: {
+                int value = random_value(25);
+                elements.insert(std::upper_bound(elements.begin(),
+                                                 elements.end(), value),
+                                value);
+                tree.Add(value);
+                break;
+              }
+              case 1: {
+                int value = random_value(60);
+                assert(tree.Contains(value) == std::binary_search(
+                    elements.begin(), elements.end(), value));
+                break;
+              }
+              default: {
+                int value = random_value(75);
+                auto element_it = std::lower_bound(elements.begin(),
+                                                   elements.end(), value);
+                if (element_it != elements.end() && *element_it == value) {
+                  elements.erase(element_it);
+                }
+                tree.Erase(value);
+                break;
+              }
+            }
+          }
+        });
+      }
+      for (std::thread& writer : writers) {
+        writer.join();
+      }
+      writers_done.store(true);
+      reader.join();
+
+      std::vector<int> elements;
+      for (const std::vector<int>& part : thread_elements) {
+        elements.insert(elements.end(), part.begin(), part.end());
+      }
+      std::sort(elements.begin(), elements.end());
+      assert(tree.Size() == elements.size());
+      assert(tree.ToSortedArray() == elements);
+      std::cout << "Passed: concurrent, max_element_value = "
+                << max_element_value << std::endl;
+    }
+  }
+
+#ifdef RUN_BENCHMARKS
+  {
+    // Снимок каждые kInterval записей, хранятся последние kKept снимков:
+    // персистентное дерево против глубоких копий BinarySearchTree.
+    const int kKeys = 1'000'000;
+    const int kWrites = 200'000;
+    const int kInterval = 10'000;
+    const size_t kKept = 10;
+    std::mt19937 generator(2018);
+    std::vector<int> writes(kWrites);
+    for (int& value : writes) {
+      value = static_cast<int>(generator() % (2 * kKeys));
+    }
+
+    PersistentSearchTree<int> tree;
+    for (int i = 0; i < kKeys; ++i) {
+      tree.Add(2 * i);
+    }
+    size_t rss_base = ResidentSetKilobytes();
+    size_t nodes_before = tree.NodesCreated();
+    std::vector<PersistentSearchTree<int>> snapshots;
+    double persistent_elapsed = MeasureMilliseconds([&] {
+      for (int i = 0; i < kWrites; ++i) {
+        if (i % 2 == 0) {
+          tree.Add(writes[i]);
+        } else {
+          tree.Erase(writes[i]);
+        }
+        if (i % kInterval == 0) {
+          if (snapshots.size() == kKept) {
+            snapshots.erase(snapshots.begin());
+          }
+          snapshots.push_back(tree.Snapshot());
+        }
+      }
+    });
+    size_t rss_after = ResidentSetKilobytes();
+    std::cout << "[BENCH] Persistent: " << persistent_elapsed << " ms, "
+              << double(tree.NodesCreated() - nodes_before) / kWrites
+              << " nodes copied per write, snapshots +"
+              << (rss_after - rss_base) / 1024 << " MiB" << std::endl;
+    snapshots.clear();
+    tree = PersistentSearchTree<int>();
+
+    BinarySearchTree<int> mutable_tree;
+    for (int i = 0; i < kKeys; ++i) {
+      mutable_tree.Add(2 * i);
+    }
+    rss_base = ResidentSetKilobytes();
+    std::vector<BinarySearchTree<int>> copies;
+    double copying_elapsed = MeasureMilliseconds([&] {
+      for (int i = 0; i < kWrites; ++i) {
+        if (i % 2 == 0) {
+          mutable_tree.Add(writes[i]);
+        } else {
+          mutable_tree.Erase(writes[i]);
+        }
+        if (i % kInterval == 0) {
+          if (copies.size() == kKept) {
+            copies.erase(copies.begin());
+          }
+          std::vector<int> sorted = mutable_tree.ToSortedArray();
+          copies.emplace_back();
+          copies.back().BuildFromSorted(sorted.begin(), sorted.end());
+        }
+      }
+    });
+    rss_after = ResidentSetKilobytes();
+    std::cout << "[BENCH] Deep copies: " << copying_elapsed << " ms, "
+              << double(kKeys) / kInterval
+              << " nodes copied per write, copies +"
+              << (rss_after - rss_base) / 1024 << " MiB" << std::endl;
+  }
+  {
+    // Загрузка снимка: BuildFromSorted против последовательных Add.
+    const int kKeys = 10'000'000;
+    std::vector<int> keys(kKeys);
+    for (int i = 0; i < kKeys; ++i) {
+      keys[i] = 3 * i;
+    }
+    BinarySearchTree<int> built;
+    double build_elapsed = MeasureMilliseconds([&] {
+      built.BuildFromSorted(keys.begin(), keys.end());
+    });
+    BinarySearchTree<int> added;
+    double add_elapsed = MeasureMilliseconds([&] {
+      for (int key : keys) {
+        added.Add(key);
+      }
+    });
+    std::cout << "[BENCH] Load " << kKeys << " sorted keys: BuildFromSorted "
+              << build_elapsed << " ms, Add " << add_elapsed << " ms"
+              << std::endl;
+
+    double split_elapsed = MeasureMilliseconds([&] {
+      BinarySearchTree<int> upper = built.Split(3 * (kKeys / 2));
+      built.Merge(upper);
+    });
+    std::vector<int> other_keys(kKeys / 10);
+    for (int i = 0; i < kKeys / 10; ++i) {
+      other_keys[i] = 30 * i + 1;
+    }
+    BinarySearchTree<int> other;
+    other.BuildFromSorted(other_keys.begin(), other_keys.end());
+    double merge_elapsed = MeasureMilliseconds([&] { built.Merge(other); });
+    assert(built.Size() == size_t(kKeys + kKeys / 10));
+    std::cout << "[BENCH] Split + disjoint Merge: " << split_elapsed
+              << " ms, interleaved Merge of " << kKeys / 10 << " keys: "
+              << merge_elapsed << " ms" << std::endl;
+  }
+  {
+    // Холодный старт: текстовый дамп против двоичного файла, загруженного
+    // в дерево или отображённого в память без десериализации.
+    const int kKeys = 10'000'000;
+    const int kLookups = 1000;
+    const std::string kTextPath = "search_tree_keys.txt";
+    const std::string kBinaryPath = "search_tree_keys.bin";
+    std::mt19937 keys_generator(2021);
+    std::vector<int> keys(kKeys);
+    for (int& key : keys) {
+      key = static_cast<int>(keys_generator());
+    }
+    std::sort(keys.begin(), keys.end());
+    {
+      BinarySearchTree<int> tree;
+      tree.BuildFromSorted(keys.begin(), keys.end());
+      std::ofstream text(kTextPath);
+      for (int key : keys) {
+        text << key << '\n';
+      }
+      std::ofstream binary(kBinaryPath, std::ios::binary);
+      tree.Serialize(binary);
+    }
+    std::vector<int> lookups(kLookups);
+    for (int& lookup : lookups) {
+      lookup = keys[keys_generator() % kKeys];
+    }
+
+    DropFileCache(kTextPath);
+    size_t found = 0;
+    double text_elapsed = MeasureMilliseconds([&] {
+      std::ifstream text(kTextPath);
+      std::vector<int> loaded;
+      loaded.reserve(kKeys);
+      int key;
+      while (text >> key) {
+        loaded.push_back(key);
+      }
+      BinarySearchTree<int> tree;
+      tree.BuildFromSorted(loaded.begin(), loaded.end());
+      for (int lookup : lookups) {
+        found += tree.Contains(lookup);
+      }
+    });
+    DropFileCache(kBinaryPath);
+    double load_elapsed = MeasureMilliseconds([&] {
+      std::vector<int64_t> loaded = MappedSortedKeys(kBinaryPath)
+                                        .ToSortedArray();
+      BinarySearchTree<int> tree;
+      tree.BuildFromSorted(loaded.begin(), loaded.end());
+      for (int lookup : lookups) {
+        found += tree.Contains(lookup);
+      }
+    });
+    DropFileCache(kBinaryPath);
+    double mapped_elapsed = MeasureMilliseconds([&] {
+      MappedSortedKeys view(kBinaryPath);
+      for (int lookup : lookups) {
+        found += view.Contains(lookup);
+      }
+    });
+    assert(found == size_t(3 * kLookups));
+    std::ifstream text_file(kTextPath, std::ios::ate);
+    std::ifstream binary_file(kBinaryPath, std::ios::ate);
+    std::cout << "[BENCH] Cold start with " << kKeys << " keys and "
+              << kLookups << " lookups: text "
+              << text_file.tellg() / (1 << 20) << " MiB "
+              << text_elapsed << " ms, binary "
+              << binary_file.tellg() / (1 << 20) << " MiB loaded "
+              << load_elapsed << " ms, mapped " << mapped_elapsed << " ms"
+              << std::endl;
+    std::remove(kTextPath.c_str());
+    std::remove(kBinaryPath.c_str());
+  }
+  {
+    // Пакетный поиск против цикла Contains в дереве, не помещающемся в кэш.
+    const int kKeys = 10'000'000;
+    const int kRounds = 10;
+    std::mt19937 batch_generator(2024);
+    BinarySearchTree<int> tree;
+    for (int i = 0; i < kKeys; ++i) {
+      tree.Add(static_cast<int>(batch_generator() % (4u * kKeys)));
+    }
+    for (size_t batch_size : {10'000, 100'000}) {
+      std::vector<int> keys(batch_size);
+      for (int& key : keys) {
+        key = static_cast<int>(batch_generator() % (4u * kKeys));
+      }
+      std::unique_ptr<bool[]> found(new bool[batch_size]);
+      size_t loop_found = 0;
+      double loop_elapsed = MeasureMilliseconds([&] {
+        for (int round = 0; round < kRounds; ++round) {
+          for (size_t i = 0; i < batch_size; ++i) {
+            found[i] = tree.Contains(keys[i]);
+          }
+          loop_found += std::count(found.get(), found.get() + batch_size,
+                                   true);
+        }
+      });
+      size_t batch_found = 0;
+      double batch_elapsed = MeasureMilliseconds([&] {
+        for (int round = 0; round < kRounds; ++round) {
+          tree.ContainsBatch(keys.data(), batch_size, found.get());
+          batch_found += std::count(found.get(), found.get() + batch_size,
+                                    true);
+        }
+      });
+      assert(loop_found == batch_found);
+      double lookups = 1e-3 * kRounds * batch_size;
+      std::cout << "[BENCH] Batches of " << batch_size << " on " << kKeys
+                << " keys: Contains loop " << lookups / loop_elapsed
+                << " Mlookups/s, ContainsBatch "
+                << lookups / batch_elapsed << " Mlookups/s" << std::endl;
+    }
+  }
+  {
+    // 90% Contains, 5% Add, 5% Erase над деревом из 1M ключей: дерево с
+    // локальными блокировками против BinarySearchTree под общим мьютексом.
+    const int kKeys = 1'000'000;
+    const int kOperations = 4'000'000;
+    std::mt19937 generator(2018);
+    ConcurrentBinarySearchTree<int> concurrent_tree;
+    BinarySearchTree<int> locked_tree;
+    std::mutex tree_mutex;
+    for (int i = 0; i < kKeys; ++i) {
+      int value = static_cast<int>(generator() % (2 * kKeys));
+      concurrent_tree.Add(value);
+      locked_tree.Add(value);
+    }
+
+    // Число найденных ключей; не даёт компилятору выбросить поиск.
+    std::atomic<size_t> found(0);
+    auto run = [&found](int threads_count, auto operation) {
+      std::vector<std::thread> threads;
+      return MeasureMilliseconds([&] {
+        for (int t = 0; t < threads_count; ++t) {
+          threads.emplace_back([t, threads_count, &operation, &found] {
+            std::mt19937 thread_generator(t);
+            size_t thread_found = 0;
+            for (int i = 0; i < kOperations / threads_count; ++i) {
+              uint32_t random = thread_generator();
+              thread_found += operation(
+                  random % 100, static_cast<int>(random % (2 * kKeys)));
+            }
+            found += thread_found;
+          });
+        }
+        for (std::thread& thread : threads) {
+          thread.join();
+        }
+      });
+    };
+    for (int threads_count : {1, 2, 4, 8, 16, 32}) {
+      double concurrent_elapsed = run(threads_count, [&](int kind, int value) {
+        if (kind < 90) {
+          return concurrent_tree.Contains(value);
+        } else if (kind < 95) {
+          concurrent_tree.Add(value);
+        } else {
+          concurrent_tree.Erase(value);
+        }
+        return false;
+      });
+      double locked_elapsed = run(threads_count, [&](int kind, int value) {
+        std::lock_guard<std::mutex> lock(tree_mutex);
+        if (kind < 90) {
+          return locked_tree.Contains(value);
+        } else if (kind < 95) {
+          locked_tree.Add(value);
+        } else {
+          locked_tree.Erase(value);
+        }
+        return false;
+      });
+      std::cout << "[BENCH] " << threads_count << " threads: concurrent "
+                << kOperations / concurrent_elapsed / 1e3
+                << " Mops/s, global mutex "
+                << kOperations / locked_elapsed / 1e3 << " Mops/s"
+                << std::endl;
+    }
+    assert(found.load() > 0);
+  }
+  {
+    // Строковые ключи: поиск по std::string_view против std::set, которому
+    // для поиска нужен временный std::string.
+    const int kKeys = 1'000'000;
+    std::mt19937 generator(2018);
+    std::vector<std::string> keys(kKeys);
+    for (std::string& key : keys) {
+      key = "user/" + std::to_string(generator()) + "/session";
+    }
+    std::vector<std::string_view> queries(keys.begin(), keys.end());
+    std::shuffle(queries.begin(), queries.end(), generator);
+
+    BinarySearchTree<std::string, std::less<>> tree;
+    double tree_build = MeasureMilliseconds([&] {
+      for (const std::string& key : keys) {
+        tree.Add(key);
+      }
+    });
+    size_t tree_found = 0;
+    double tree_lookup = MeasureMilliseconds([&] {
+      for (std::string_view query : queries) {
+        tree_found += tree.Contains(query);
+      }
+    });
+
+    std::set<std::string> set;
+    double set_build = MeasureMilliseconds([&] {
+      for (const std::string& key : keys) {
+        set.insert(key);
+      }
+    });
+    size_t set_found = 0;
+    double set_lookup = MeasureMilliseconds([&] {
+      for (std::string_view query : queries) {
+        set_found += set.count(std::string(query));
+      }
+    });
+    assert(tree_found == set_found);
+    std::cout << "[BENCH] String keys x" << kKeys << ": tree build "
+              << tree_build << " ms, lookup " << tree_lookup
+              << " ms; std::set build " << set_build << " ms, lookup "
+              << set_lookup << " ms" << std::endl;
+  }
+  for (int keys_count : {1'000'000, 10'000'000, 100'000'000}) {
+    // Ключи - чётные числа, половина запросов попадает в дерево.
+    const int kQueries = 10'000'000;
+    std::mt19937 generator(2018);
+    std::vector<int> queries(kQueries);
+    for (int& query : queries) {
+      query = static_cast<int>(generator() % (2u * keys_count));
+    }
+
+    auto tree = std::make_unique<BinarySearchTree<int>>();
+    for (int i = 0; i < keys_count; ++i) {
+      tree->Add(2 * i);
+    }
+    size_t found = 0;
+    double tree_elapsed = MeasureMilliseconds([&] {
+      for (int query : queries) {
+        found += tree->Contains(query);
+      }
+    });
+    std::vector<int> sorted = tree->ToSortedArray();
+    tree.reset();
+
+    StaticSearchTree static_tree(sorted);
+    sorted = std::vector<int>();
+    size_t static_found = 0;
+    double static_elapsed = MeasureMilliseconds([&] {
+      for (int query : queries) {
+        static_found += static_tree.Contains(query);
+      }
+    });
+    assert(found == static_found);
+    std::cout << "[BENCH] Contains on " << keys_count << " keys: pointer tree "
+              << tree_elapsed * 1e6 / kQueries << " ns, static tree "
+              << static_elapsed * 1e6 / kQueries << " ns per query"
+              << std::endl;
+  }
+  {
+    // Дерево на пуле против std::multiset, выделяющего каждую вершину
+    // отдельно (как и прежняя реализация с new/delete на вершину).
+    const int kKeys = 10'000'000;
+    std::mt19937 generator(2018);
+    std::vector<int> keys(kKeys);
+    for (int& key : keys) {
+      key = static_cast<int>(generator());
+    }
+
+    size_t rss_before = ResidentSetKilobytes();
+    auto tree = std::make_unique<BinarySearchTree<int>>();
+    double build_elapsed = MeasureMilliseconds([&] {
+      for (int key : keys) {
+        tree->Add(key);
+      }
+    });
+    size_t rss_built = ResidentSetKilobytes();
+    double teardown_elapsed = MeasureMilliseconds([&] { tree.reset(); });
+    std::cout << "[BENCH] Pooled tree x" << kKeys << ": build "
+              << build_elapsed << " ms, teardown " << teardown_elapsed
+              << " ms, RSS +" << (rss_built - rss_before) / 1024 << " MiB, "
+              << "after teardown +"
+              << (ResidentSetKilobytes() - rss_before) / 1024 << " MiB"
+              << std::endl;
+
+    rss_before = ResidentSetKilobytes();
+    auto set = std::make_unique<std::multiset<int>>();
+    build_elapsed = MeasureMilliseconds([&] {
+      for (int key : keys) {
+        set->insert(key);
+      }
+    });
+    rss_built = ResidentSetKilobytes();
+    teardown_elapsed = MeasureMilliseconds([&] { set.reset(); });
+    std::cout << "[BENCH] Per-node new x" << kKeys << ": build "
+              << build_elapsed << " ms, teardown " << teardown_elapsed
+              << " ms, RSS +" << (rss_built - rss_before) / 1024 << " MiB"
+              << std::endl;
+  }
+  {
+    const int kSortedKeys = 10'000'000;
+    BinarySearchTree<int> tree;
+    double add_elapsed = MeasureMilliseconds([&tree] {
+      for (int i = 0; i < kSortedKeys; ++i) {
+        tree.Add(i);
+      }
+    });
+    size_t found = 0;
+    double contains_elapsed = MeasureMilliseconds([&tree, &found] {
+      for (int i = 0; i < kSortedKeys; ++i) {
+        found += tree.Contains(i);
+      }
+    });
+    assert(found == kSortedKeys);
+
+    std::cout << "[BENCH] Sorted Add x" << kSortedKeys << ": "
+              << add_elapsed << " ms, height " << tree.Height()
+              << std::endl;
+    std::cout << "[BENCH] Contains x" << kSortedKeys << ": "
+              << contains_elapsed << " ms" << std::endl;
+  }
+#endif  // RUN_BENCHMARKS
+
   return 0;
 }
 #endif